@@ -7,18 +7,31 @@
 // Created on 28.05.2020
 // by Vincent Jordan
 
-#define USE_OPENGL_PBO 1
-// Note: Enabling PBO requires OpenGL ES 3.0
-// See "#define GLFW_INCLUDE_ES3" below.
-
 // Local includes:
 #include "version.h"
 #include "inastitch/jpeg/include/Decoder.hpp"
+#include "inastitch/jpeg/include/DecoderPool.hpp"
+#include "inastitch/jpeg/include/FramePool.hpp"
 #include "inastitch/jpeg/include/Encoder.hpp"
+#include "inastitch/jpeg/include/EncoderPipeline.hpp"
+#include "inastitch/jpeg/include/MjpegHttpServer.hpp"
 #include "inastitch/jpeg/include/MjpegParser.hpp"
 #include "inastitch/jpeg/include/RtpJpegParser.hpp"
+#include "inastitch/jpeg/include/RtpJpegSender.hpp"
 #include "inastitch/opengl/include/OpenGlHelper.hpp"
+#include "inastitch/opengl/include/GainCompensator.hpp"
+#include "inastitch/opengl/include/HeadlessContext.hpp"
+#include "inastitch/opengl/include/PixelPackRing.hpp"
+#include "inastitch/opengl/include/PixelUnpackRing.hpp"
+#include "inastitch/opengl/include/TextOverlay.hpp"
+#include "inastitch/opengl/include/TextureRing.hpp"
+#include "inastitch/opengl/include/VirtualView.hpp"
+#include "inastitch/opengl/include/WarpMesh.hpp"
+#include "inastitch/opengl/include/RenditionTarget.hpp"
+#include "inastitch/opengl/include/YuvPacker.hpp"
 #include "inastitch/json/include/Matrix.hpp"
+#include "inastitch/shm/include/SharedMemoryRing.hpp"
+#include "inastitch/video/include/RawVideoWriter.hpp"
 
 // Boost includes:
 #include <boost/program_options.hpp>
@@ -40,46 +53,101 @@ namespace po = boost::program_options;
 #include <GLFW/glfw3.h>
 
 // Std includes:
+#include <algorithm>
 #include <limits>
 #include <string>
 #include <iostream>
 #include <chrono>
 #include <thread>
 #include <fstream>
+#include <cmath>
+#include <deque>
+#include <mutex>
+
+// Note: all input streams are drawn at once from one warp mesh, and sampled from
+//       one layer each of a texture array. Per-stream settings are in a uniform block:
+//       "visible" is zero when the stream has no frame yet, "gain" compensates exposure and color.
+static const auto maxInputStreamCount = 16;
+// Note: array size must be 'maxInputStreamCount'
+#define CAMERA_UNIFORM_BLOCK                                      \
+    "struct Camera {\n"                                           \
+    "   highp vec4 texScale;\n"                                   \
+    "   highp vec4 gain;\n"                                       \
+    "   highp float visible;\n"                                   \
+    "};\n"                                                        \
+    "layout(std140) uniform Cameras {\n"                          \
+    "   Camera cameras[16];\n"                                    \
+    "};\n"
+
+// std140 layout of "Camera"
+struct CameraUniforms
+{
+    // ratio of the frame size to the texture size, for luma (x, y) and chroma (z, w)
+    float texScale[4];
+    // red, green and blue gains (see "GainCompensator.hpp")
+    float gain[4];
+    float visible;
+    // Note: struct size is padded to vec4
+    float padding[3];
+};
+static_assert(sizeof(CameraUniforms) == 48, "CameraUniforms does not match std140 layout");
 
 // Note: the vertex shader describes how vertices (i.e., the 3 coords of a triangle)
-//       are transformed.
-static const GLchar* vertexShaderSource = R""""(
-#version 100
-precision mediump float;
-
-attribute vec2 position;
-attribute vec2 texCoord;
-
-varying vec2 texCoordVar;
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 proj;
+//       are transformed. Warp, lens distortion and projection are baked in the mesh,
+//       the virtual view (pan/tilt/zoom) is applied on top.
+static const GLchar* vertexShaderSource =
+"#version 300 es\n"
+"precision highp float;\n"
+CAMERA_UNIFORM_BLOCK
+R""""(
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec2 texCoord;
+layout(location = 2) in float camera;
+
+uniform mat4 virtualView;
+
+out vec2 texCoordVar;
+flat out int cameraIdx;
 
 void main() {
-   gl_Position = proj * view * model * vec4(position.x, position.y, 0.0f, 1.0f);
+   cameraIdx = int(camera);
+   gl_Position = virtualView * position * cameras[cameraIdx].visible;
    texCoordVar = texCoord;
 }
 )"""";
 
 // Note: the pixel shader describes how individual pixels (i.e., the texture) within
 //       a triangle are transformed.
-static const GLchar* fragmentShaderSource = R""""(
-#version 100
-precision mediump float;
-
-varying vec2 texCoordVar;
-uniform sampler2D texture1;
-uniform mat3 warp;
+static const GLchar* fragmentShaderSource =
+"#version 300 es\n"
+"precision mediump float;\n"
+"precision mediump sampler2DArray;\n"
+CAMERA_UNIFORM_BLOCK
+R""""(
+in vec2 texCoordVar;
+flat in int cameraIdx;
+uniform sampler2DArray textureY;
+uniform sampler2DArray textureU;
+uniform sampler2DArray textureV;
+uniform bool isYuv;
+
+out vec4 fragColor;
 
 void main() {
-   vec3 dst = warp * vec3((texCoordVar.x+1.0), texCoordVar.y, 1.0f);
-   gl_FragColor = texture2D(texture1, vec2((dst.x/dst.z), (dst.y/dst.z)) );
+   // Note: wraps as GL_REPEAT, then scales to the region of the texture holding the frame
+   vec2 texCoord = fract(texCoordVar);
+   vec4 texScale = cameras[cameraIdx].texScale;
+   float layer = float(cameraIdx);
+   if(isYuv) {
+      // JFIF (full range) YCbCr to RGB, "textureY" holds the Y plane
+      float y = texture(textureY, vec3(texCoord * texScale.xy, layer)).r;
+      float u = texture(textureU, vec3(texCoord * texScale.zw, layer)).r - 0.5;
+      float v = texture(textureV, vec3(texCoord * texScale.zw, layer)).r - 0.5;
+      fragColor = vec4(y + 1.402*v, y - 0.344136*u - 0.714136*v, y + 1.772*u, 1.0);
+   } else {
+      fragColor = texture(textureY, vec3(texCoord * texScale.xy, layer));
+   }
+   fragColor.rgb *= cameras[cameraIdx].gain.rgb;
 }
 )"""";
 
@@ -88,52 +156,92 @@ static const GLfloat topRightX    = -0.320f, topRightY    =  0.240f;
 static const GLfloat bottomRightX = -0.320f, bottomRightY = -0.240f;
 static const GLfloat bottomLeftX  =  0.320f, bottomLeftY  = -0.240f;
 static const GLfloat topLeftX     =  0.320f, topLeftY     =  0.240f;
-static const GLfloat vertices[] = {
-    // position (2D)            // texCoord
-    topRightX,    topRightY,    0.0f, 0.0f,
-    bottomRightX, bottomRightY, 0.0f, 1.0f,
-    bottomLeftX,  bottomLeftY,  1.0f, 1.0f,
-
-    bottomLeftX,  bottomLeftY,  1.0f, 1.0f,
-    topLeftX,     topLeftY,     1.0f, 0.0f,
-    topRightX,    topRightY,    0.0f, 0.0f
-};
 // Note: UV texture coordinates are "inverted" to flip texture image,
-//       since OpenGL reads image "upside-down".
+//       since OpenGL reads image "upside-down" (i.e., UV 0,0 is at "topRight").
 
 struct GenericInputStreamContext
 {
-    GenericInputStreamContext(uint32_t maxRgbaBufferSize)
-        : rgbaBufferSize(maxRgbaBufferSize)
-    {
-        jpegDecoderPtr = new inastitch::jpeg::Decoder(maxRgbaBufferSize);
-    }
+    GenericInputStreamContext(uint32_t maxRgbaBufferSize, inastitch::jpeg::DecoderPool &sharedDecoderPool)
+        : framePool(framePoolSize, maxRgbaBufferSize)
+        , decoderPool(sharedDecoderPool)
+    { }
 
-    ~GenericInputStreamContext()
-    {
-        delete jpegDecoderPtr;
-    }
+    virtual ~GenericInputStreamContext() = default;
 
     virtual bool getFrame(uint32_t index) = 0;
 
     void decodeJpeg()
     {
-        rgbaBuffer = jpegDecoderPtr->decode(jpegBuffer, jpegBufferSize);
+        if(targetFrame)
+        {
+            decoderPool.decode(*targetFrame, decodeSettings, jpegBuffer, jpegBufferSize);
+            frame = std::move(targetFrame);
+        }
+        else
+        {
+            frame = decoderPool.decode(framePool, decodeSettings, jpegBuffer, jpegBufferSize);
+        }
+        frame->absTime = absTime;
     }
 
     void decodeWhite()
     {
-        for(uint32_t i=0; i<rgbaBufferSize; i++)
+        // Note: frame size is unknown until the first frame is decoded
+        if(!frame)
         {
-            jpegDecoderPtr->rgbaBuffer()[i] = 0xFF;
+            return;
         }
+
+        // same geometry as the previous frame
+        auto whiteFrame = targetFrame ? std::move(targetFrame) : framePool.acquire();
+        whiteFrame->width = frame->width;
+        whiteFrame->height = frame->height;
+        whiteFrame->cropX = frame->cropX;
+        whiteFrame->cropY = frame->cropY;
+        whiteFrame->fullWidth = frame->fullWidth;
+        whiteFrame->fullHeight = frame->fullHeight;
+        whiteFrame->isYuv = frame->isYuv;
+        whiteFrame->absTime = absTime;
+
+        if(whiteFrame->isYuv)
+        {
+            // white is full luma and neutral chroma
+            for(uint32_t planeIdx=0; planeIdx<inastitch::jpeg::Frame::yuvPlaneCount; planeIdx++)
+            {
+                whiteFrame->yuvPlanes[planeIdx] = whiteFrame->buffer + (frame->yuvPlanes[planeIdx] - frame->buffer);
+                whiteFrame->yuvPlaneWidths[planeIdx] = frame->yuvPlaneWidths[planeIdx];
+                whiteFrame->yuvPlaneHeights[planeIdx] = frame->yuvPlaneHeights[planeIdx];
+
+                const auto planeSize = whiteFrame->yuvPlaneWidths[planeIdx] * whiteFrame->yuvPlaneHeights[planeIdx];
+                for(uint32_t i=0; i<planeSize; i++)
+                {
+                    whiteFrame->yuvPlanes[planeIdx][i] = (planeIdx == 0) ? 0xFF : 0x80;
+                }
+            }
+        }
+        else
+        {
+            for(uint32_t i=0; i<whiteFrame->bufferSize; i++)
+            {
+                whiteFrame->buffer[i] = 0xFF;
+            }
+        }
+
+        frame = whiteFrame;
     }
 
-    inastitch::jpeg::Decoder *jpegDecoderPtr = nullptr;
+    // one frame being rendered, one being dumped and one being decoded
+    static const auto framePoolSize = 3;
+    inastitch::jpeg::FramePool framePool;
+    inastitch::jpeg::DecoderPool &decoderPool;
+    inastitch::jpeg::DecoderPool::Settings decodeSettings;
+
+    // last decoded frame
+    std::shared_ptr<inastitch::jpeg::Frame> frame;
+    // Note: when set, next frame is decoded into it instead of a pooled frame
+    std::shared_ptr<inastitch::jpeg::Frame> targetFrame;
 
     unsigned char *jpegBuffer = nullptr;
-    unsigned char *rgbaBuffer = nullptr;
-    const uint32_t rgbaBufferSize;
     uint32_t jpegBufferSize;
 
     // absolute time since epoch (in us)
@@ -149,8 +257,8 @@ struct GenericInputStreamContext
 template<class FrameParser>
 struct InputStreamContext : GenericInputStreamContext
 {
-    InputStreamContext(uint32_t maxRgbaBufferSize, std::string streamLocationString)
-        : GenericInputStreamContext(maxRgbaBufferSize)
+    InputStreamContext(uint32_t maxRgbaBufferSize, std::string streamLocationString, inastitch::jpeg::DecoderPool &sharedDecoderPool)
+        : GenericInputStreamContext(maxRgbaBufferSize, sharedDecoderPool)
     {
         jpegParserPtr = new FrameParser(streamLocationString, maxRgbaBufferSize);
         // Note: assumes RGBA data is always larger than JPEG data
@@ -179,12 +287,33 @@ struct InputStreamContext : GenericInputStreamContext
 int main(int argc, char** argv)
 {
     std::string inMatrixJsonFilename;
-    std::string inFilename0, inFilename1, inFilename2;
-    std::string inSocketPort0, inSocketPort1, inSocketPort2;
+    std::vector<std::string> inFilenames;
+    std::vector<std::string> inSocketPorts;
     uint16_t inStreamWidth, inStreamHeight;
     uint16_t inTpoolSize;
+    uint16_t inSliceCount;
+    uint16_t inTextureCount;
     uint16_t windowWidth, windowHeight;
+    std::string outProjectionName;
+    std::string viewStr;
+    uint16_t outTpoolSize, outStripCount, outQueueSize;
     std::string outFilename;
+    std::vector<std::string> outRtpDestinations;
+    uint64_t outRtpMaxBitrate;
+    std::string outHttpBindStr;
+    uint16_t outHttpMaxClientCount;
+    uint32_t outTargetFrameSize;
+    uint64_t outTargetBitrate;
+    bool isOutReencodeEnabled = false;
+    std::string outShmName, outShmJpegName;
+    uint16_t outShmSlotCount;
+    std::string outRawFilename, outRawFormatName;
+    uint16_t outRawFrameRate;
+    std::vector<std::string> outRenditionStrs;
+    std::vector<std::string> outViewStrs;
+    uint16_t outViewTpoolSize;
+    std::string outReadbackName;
+    uint16_t outReadbackBufferCount;
     uint64_t maxDumpFrameCount;
     std::string frameDumpPath;
     uint64_t frameDumpOffsetId;
@@ -194,6 +323,14 @@ int main(int argc, char** argv)
     bool isDumpFrameIdRelativeToOffset = false;
     bool isOverlayEnabled = false;
     bool isStatsEnabled = false;
+    bool isYuvEnabled = false;
+    bool isScaledDecodeEnabled = false;
+    bool isCropDecodeEnabled = false;
+    bool isPboUploadEnabled = false;
+    bool isOutYuvEnabled = false;
+    bool isHeadless = false;
+    bool isViewStdinEnabled = false;
+    bool isGainCompensationEnabled = false;
 
     bool isFileInput = false;
 
@@ -209,33 +346,90 @@ int main(int argc, char** argv)
             ("in-matrix", po::value<std::string>(&inMatrixJsonFilename),
              "Read matrix from JSON FILENAME")
 
-            ("in-file0", po::value<std::string>(&inFilename0),
-             "Read MJPEG from FILENAME for central texture (0)")
-            ("in-file1", po::value<std::string>(&inFilename1),
-             "Read MJPEG from FILENAME for left texture (1)")
-            ("in-file2", po::value<std::string>(&inFilename2),
-             "Read MJPEG from FILENAME for right texture (2)")
+            ("in-file", po::value<std::vector<std::string>>(&inFilenames),
+             "Read MJPEG from FILENAME, one per camera in the matrix file order (can be repeated)")
+
+            ("in-port", po::value<std::vector<std::string>>(&inSocketPorts),
+             "Listen for RTP/JPEG on PORT, one per camera in the matrix file order (can be repeated)")
 
-            ("in-port0", po::value<std::string>(&inSocketPort0),
-             "Listen for RTP/JPEG on PORT for central texture (0)")
-            ("in-port1", po::value<std::string>(&inSocketPort1),
-             "Listen for RTP/JPEG on PORT for left texture (1)")
-            ("in-port2", po::value<std::string>(&inSocketPort2),
-             "Listen for RTP/JPEG on PORT for right texture (2)")
+            // Note: deprecated, kept for existing launch scripts (same as --in-file and --in-port in this order)
+            ("in-file0", po::value<std::string>(), "Deprecated, use --in-file")
+            ("in-file1", po::value<std::string>(), "Deprecated, use --in-file")
+            ("in-file2", po::value<std::string>(), "Deprecated, use --in-file")
+            ("in-port0", po::value<std::string>(), "Deprecated, use --in-port")
+            ("in-port1", po::value<std::string>(), "Deprecated, use --in-port")
+            ("in-port2", po::value<std::string>(), "Deprecated, use --in-port")
 
             ("in-width", po::value<uint16_t>(&inStreamWidth)->default_value(640),
              "Input stream WIDTH")
             ("in-height", po::value<uint16_t>(&inStreamHeight)->default_value(480),
              "Input stream HEIGHT")
-            ("in-tpool-size", po::value<uint16_t>(&inTpoolSize)->default_value(3),
-             "Thread pool SIZE for input stream decoding")
+            ("in-tpool-size", po::value<uint16_t>(&inTpoolSize)->default_value(0),
+             "Thread pool SIZE for input stream decoding (0 for one thread per camera)")
+            ("in-slice-count", po::value<uint16_t>(&inSliceCount)->default_value(1),
+             "Max COUNT of slices decoded in parallel per input frame (requires restart markers)")
+            ("in-yuv", "Decode input JPEG to YUV planes, color conversion is done by the GPU")
+            ("in-scale-decode", "Decode input JPEG at the lowest resolution that is visible in the output")
+            ("in-crop-decode", "Decode input JPEG only within the region that is visible in the output")
+            ("in-pbo", "Decode input JPEG directly into pixel unpack buffers, textures are updated from those")
+            ("in-textures", po::value<uint16_t>(&inTextureCount)->default_value(3),
+             "COUNT of textures per input stream, so that uploads do not wait for previous draws")
+            ("in-gain-compensation", "Compensate exposure and color differences between input streams, from their overlaps")
 
             ("out-width", po::value<uint16_t>(&windowWidth)->default_value(1920),
              "OpenGL rendering and output stream WIDTH")
             ("out-height", po::value<uint16_t>(&windowHeight)->default_value(480),
              "OpenGL rendering and output stream HEIGHT")
+            ("out-projection", po::value<std::string>(&outProjectionName)->default_value("rectilinear"),
+             "Output PROJECTION: rectilinear, cylindrical or spherical")
+            ("view", po::value<std::string>(&viewStr)->default_value("0,0,1"),
+             "Virtual camera PAN,TILT,ZOOM: view center in output coordinates (-1 to 1) and magnification")
+            ("view-stdin", "Read virtual camera PAN TILT ZOOM lines from stdin at runtime")
             ("out-file", po::value<std::string>(&outFilename),
              "Write output MJPEG to FILENAME")
+            ("out-tpool-size", po::value<uint16_t>(&outTpoolSize)->default_value(2),
+             "Thread pool SIZE for output stream encoding")
+            ("out-strip-count", po::value<uint16_t>(&outStripCount)->default_value(1),
+             "COUNT of strips encoded in parallel per output frame (joined with restart markers)")
+            ("out-queue-size", po::value<uint16_t>(&outQueueSize)->default_value(4),
+             "Max COUNT of output frames waiting for encoding, extra frames are dropped")
+            ("out-rtp", po::value<std::vector<std::string>>(&outRtpDestinations),
+             "Send output RTP/JPEG to ADDRESS:PORT, unicast or multicast (can be repeated)")
+            ("out-rtp-bitrate", po::value<uint64_t>(&outRtpMaxBitrate)->default_value(50000000),
+             "Pace output RTP/JPEG packets to BITRATE (in bit/s, 0 to send as fast as possible)")
+            ("out-http", po::value<std::string>(&outHttpBindStr),
+             "Serve output as HTTP multipart MJPEG on [ADDRESS:]PORT, on loopback only unless ADDRESS is given (e.g., 0.0.0.0:8080)")
+            ("out-http-clients", po::value<uint16_t>(&outHttpMaxClientCount)->default_value(16),
+             "Maximum COUNT of HTTP clients")
+            ("out-target-size", po::value<uint32_t>(&outTargetFrameSize)->default_value(0),
+             "Choose output JPEG quality of each frame to reach SIZE (in bytes)")
+            ("out-target-bitrate", po::value<uint64_t>(&outTargetBitrate)->default_value(0),
+             "Choose output JPEG quality of each frame to reach BITRATE (in bit/s)")
+            ("out-reencode", "Re-encode output frames that overshoot the target size or bitrate")
+            ("out-shm", po::value<std::string>(&outShmName),
+             "Publish raw output frames (RGBA, or YUV with --out-yuv) to shared memory NAME (e.g., /inastitch, or memfd:inastitch)")
+            ("out-shm-jpeg", po::value<std::string>(&outShmJpegName),
+             "Publish output JPEG frames to shared memory NAME (e.g., /inastitch-jpeg, or memfd:inastitch-jpeg)")
+            ("out-shm-slots", po::value<uint16_t>(&outShmSlotCount)->default_value(4),
+             "COUNT of frames in each shared memory ring")
+            ("out-yuv", "Convert output to YUV 4:2:0 planes on the GPU, only those are read back and encoded")
+            ("out-raw", po::value<std::string>(&outRawFilename),
+             "Write raw YUV 4:2:0 output frames to FILENAME or named pipe, PTS are written to FILENAME.pts (implies --out-yuv)")
+            ("out-raw-format", po::value<std::string>(&outRawFormatName)->default_value("y4m"),
+             "Raw output FORMAT: y4m, i420 or nv12")
+            ("out-raw-fps", po::value<uint16_t>(&outRawFrameRate)->default_value(30),
+             "Nominal frame RATE in Y4M header (actual timing is in PTS file)")
+            ("out-rendition", po::value<std::vector<std::string>>(&outRenditionStrs),
+             "Write a downscaled WIDTHxHEIGHT:FILENAME MJPEG rendition of the output (can be repeated)")
+            ("out-view", po::value<std::vector<std::string>>(&outViewStrs),
+             "Render another view WIDTHxHEIGHT:PROJECTION:PAN,TILT,ZOOM:SINK of the same input frames, "
+             "SINK being an MJPEG FILENAME or rtp://ADDRESS:PORT (can be repeated)")
+            ("out-view-tpool-size", po::value<uint16_t>(&outViewTpoolSize)->default_value(2),
+             "Thread pool SIZE for encoding other views, shared by all of them (at least one thread per view)")
+            ("out-readback", po::value<std::string>(&outReadbackName)->default_value("pbo"),
+             "Output read back STRATEGY: sync (waits for rendering), pbo (ring of buffers handed to outputs) or none")
+            ("out-readback-buffers", po::value<uint16_t>(&outReadbackBufferCount)->default_value(3),
+             "COUNT of buffers in the pbo read back ring (frames read back, being mapped or being output)")
 
             ("max-dump-frame", po::value<uint64_t>(&maxDumpFrameCount)->default_value(std::numeric_limits<uint64_t>::max()),
              "Maximum frame count")
@@ -250,6 +444,8 @@ int main(int argc, char** argv)
             ("frame-dump-id-from-0", "Dump frame ID relative to offset (i.e., always starts at 0), rather start of stream")
             ("print-overlay", "Print text overlay on output frame")
 
+            ("headless", "Render offscreen without window (e.g., on a server without display), as fast as possible")
+
             ("stats,s", "Print stats")
             ("help,h", "Show help")
         ;
@@ -275,161 +471,1001 @@ int main(int argc, char** argv)
             isOverlayEnabled = true;
         }
 
+        if(vm.count("in-yuv")) {
+            isYuvEnabled = true;
+        }
+
+        if(vm.count("in-scale-decode")) {
+            isScaledDecodeEnabled = true;
+        }
+
+        if(vm.count("in-crop-decode")) {
+            isCropDecodeEnabled = true;
+        }
+
+        if(vm.count("in-pbo")) {
+            isPboUploadEnabled = true;
+        }
+
+        if(vm.count("in-gain-compensation")) {
+            isGainCompensationEnabled = true;
+        }
+
+        if(vm.count("headless")) {
+            isHeadless = true;
+        }
+
+        if(vm.count("view-stdin")) {
+            isViewStdinEnabled = true;
+        }
+
+        if(vm.count("out-yuv")) {
+            isOutYuvEnabled = true;
+        }
+
+        if(vm.count("out-raw")) {
+            // Note: raw output is YUV, packed by the GPU
+            isOutYuvEnabled = true;
+        }
+
+        if(vm.count("out-reencode")) {
+            isOutReencodeEnabled = true;
+        }
+
         frameDumpOffsetTime = std::strtoull(frameDumpOffsetTimeStr.c_str(), nullptr, 0);
 
-        if( (vm.count("in-file0") || vm.count("in-file1") || vm.count("in-file2")) )
+        // numbered inputs (deprecated) are mapped to the repeated form
+        // Note: they cannot be mixed with it, nor skip a number
+        auto mapNumberedInputs = [&](const std::string &optionName, std::vector<std::string> &values)
+        {
+            const uint32_t numberedCount = 3;
+            bool isNumberedUsed = false;
+            for(uint32_t idx=0; idx<numberedCount; idx++)
+            {
+                isNumberedUsed = isNumberedUsed || vm.count(optionName + std::to_string(idx));
+            }
+            if(!isNumberedUsed)
+            {
+                return true;
+            }
+            if(!values.empty())
+            {
+                std::cout << "Cannot mix --" << optionName << " and --" << optionName << "0/1/2" << std::endl;
+                return false;
+            }
+
+            std::cout << "Warning: --" << optionName << "0/1/2 are deprecated, use --" << optionName << " (repeated)" << std::endl;
+            for(uint32_t idx=0; idx<numberedCount; idx++)
+            {
+                const auto numberedName = optionName + std::to_string(idx);
+                if(!vm.count(numberedName))
+                {
+                    break;
+                }
+                values.push_back(vm[numberedName].as<std::string>());
+            }
+            for(uint32_t idx=values.size(); idx<numberedCount; idx++)
+            {
+                if(vm.count(optionName + std::to_string(idx)))
+                {
+                    std::cout << "Missing --" << optionName << idx - 1 << " before --" << optionName << idx << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        };
+        if(!mapNumberedInputs("in-file", inFilenames) || !mapNumberedInputs("in-port", inSocketPorts))
+        {
+            return 0;
+        }
+
+        if(!inFilenames.empty())
         {
             isFileInput = true;
         }
 
         // Should not mix ile and network input
-        if( isFileInput &&
-            (vm.count("in-port0") || vm.count("in-port1") || vm.count("in-port2"))   )
+        if( isFileInput && !inSocketPorts.empty() )
         {
             std::cout << "Cannot mix file and network stream inputs" << std::endl;
             return 0;
         }
     }
 
-    std::cout << "Input stream threads: " << inTpoolSize << std::endl;
-    boost::asio::thread_pool threadPoolOutStream(1);
+    inastitch::video::RawVideoWriter::Format outRawFormat;
+    if(!inastitch::video::RawVideoWriter::parseFormat(outRawFormatName, outRawFormat))
+    {
+        std::cout << "Unknown raw output format " << outRawFormatName << std::endl;
+        return 0;
+    }
+
+    inastitch::opengl::WarpMesh::Projection outProjection;
+    if(!inastitch::opengl::WarpMesh::parseProjection(outProjectionName, outProjection))
+    {
+        std::cout << "Unknown output projection " << outProjectionName << std::endl;
+        return 0;
+    }
+
+    // Note: view can be changed at runtime, from stdin or from the keyboard of the window
+    inastitch::opengl::VirtualView virtualView;
+    {
+        float pan, tilt, zoom;
+        if(!inastitch::opengl::VirtualView::parse(viewStr, pan, tilt, zoom))
+        {
+            std::cout << "Invalid view " << viewStr << std::endl;
+            return 0;
+        }
+        virtualView.set(pan, tilt, zoom);
+    }
+
+    const glm::mat4 identMat4 = glm::mat4(1.0f);
+    const glm::mat4 initialViewMat = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -2.0f));
+    const glm::mat4 projMat = glm::perspective(glm::radians(45.0f), static_cast<float>(windowWidth)/windowHeight, 0.1f, 100.0f);
+
+    // per-camera matrices
+    std::vector<glm::mat4> modelMat;
+    std::vector<glm::mat4> viewMat;
+    std::vector<glm::mat3> texWarpMat;
+    std::vector<std::unique_ptr<inastitch::opengl::WarpMesh::Lens>> texLens;
+
+    const auto outStreamMaxRgbBufferSize = windowWidth * windowHeight * 3;
+    // Note: JPEG data should be smaller than raw RGB data
+
+    // read matrix settings from JSON file
+    // Note: cameras are listed in a "cameras" array, or as "texture0", "texture1"... objects (legacy format)
+    {
+        const tao::json::value json = tao::json::from_file(inMatrixJsonFilename);
+
+        std::vector<const tao::json::value*> cameraJsons;
+        std::vector<std::string> cameraNames;
+        if(const auto camerasJson = json.find("cameras"))
+        {
+            for(const auto &cameraJson : camerasJson->get_array())
+            {
+                cameraNames.push_back("camera" + std::to_string(cameraJsons.size()));
+                cameraJsons.push_back(&cameraJson);
+            }
+        }
+        else
+        {
+            while(const auto textureJson = json.find("texture" + std::to_string(cameraJsons.size())))
+            {
+                cameraNames.push_back("texture" + std::to_string(cameraJsons.size()));
+                cameraJsons.push_back(textureJson);
+            }
+        }
 
-    GLuint glShaderProgram, glVextexBufferObject;
-    GLint glShaderPositionAttrib, glShaderTexCoordAttrib;
-    GLint glShaderModelMatrixUni, glShaderViewMatrixUni, glShaderProjMatrixUni;
-    GLint glShaderWarpMatrixUni;
-    GLFWwindow* glWindow;
+        if( cameraJsons.empty() || (cameraJsons.size() > maxInputStreamCount) )
+        {
+            std::cout << "Matrix file must define 1 to " << maxInputStreamCount << " cameras" << std::endl;
+            return 0;
+        }
+
+        using namespace inastitch::json;
+        for(uint32_t camIdx=0; camIdx<cameraJsons.size(); camIdx++)
+        {
+            const auto &cameraJson = *cameraJsons[camIdx];
+            modelMat.push_back(identMat4);
+            viewMat.push_back(initialViewMat);
+            texWarpMat.push_back(glm::mat3(1.0f));
+            jsonToGlmMat4(cameraJson.as<std::vector<float>>("model"), modelMat[camIdx]);
+            jsonToGlmMat4(cameraJson.as<std::vector<float>>("view"), viewMat[camIdx]);
+            jsonToGlmMat3(cameraJson.as<std::vector<float>>("warp"), texWarpMat[camIdx]);
+
+            // optional lens calibration, as OpenCV camera matrix and distortion coefficients (in input pixels)
+            texLens.emplace_back();
+            const auto lensJson = cameraJson.find("lens");
+            if(lensJson)
+            {
+                const auto cameraMatrix = lensJson->as<std::vector<float>>("matrix");
+                const auto distCoeffs = lensJson->as<std::vector<float>>("distortion");
+                if( (cameraMatrix.size() != 9) || (distCoeffs.size() < 4) )
+                {
+                    std::cout << "Invalid lens for " << cameraNames[camIdx] << std::endl;
+                    return 0;
+                }
+
+                auto lens = std::make_unique<inastitch::opengl::WarpMesh::Lens>();
+                lens->focal = glm::vec2(cameraMatrix[0] / inStreamWidth, cameraMatrix[4] / inStreamHeight);
+                lens->center = glm::vec2(cameraMatrix[2] / inStreamWidth, cameraMatrix[5] / inStreamHeight);
+                lens->k1 = distCoeffs[0];
+                lens->k2 = distCoeffs[1];
+                lens->p1 = distCoeffs[2];
+                lens->p2 = distCoeffs[3];
+                lens->k3 = (distCoeffs.size() > 4) ? distCoeffs[4] : 0.0f;
+                texLens[camIdx] = std::move(lens);
+            }
+        }
+    }
+    const uint32_t cameraCount = modelMat.size();
+
+    const auto inputCount = isFileInput ? inFilenames.size() : inSocketPorts.size();
+    if(inputCount != cameraCount)
+    {
+        std::cout << "Matrix file defines " << cameraCount << " cameras, but " << inputCount << " inputs are given" << std::endl;
+        return 0;
+    }
+
+    if(inTpoolSize == 0)
+    {
+        inTpoolSize = cameraCount;
+    }
+
+    // output read back strategy
+    // Note: 'Sync' reads into output frames, 'PixelPackRing' hands over mapped buffers one or more frames later
+    enum class OutReadback { Sync, PixelPackRing, None };
+    OutReadback outReadback;
+    if(outReadbackName == "sync") {
+        outReadback = OutReadback::Sync;
+    } else if(outReadbackName == "pbo") {
+        outReadback = OutReadback::PixelPackRing;
+    } else if(outReadbackName == "none") {
+        outReadback = OutReadback::None;
+    } else {
+        std::cout << "Unknown output read back strategy " << outReadbackName << std::endl;
+        return 0;
+    }
+
+    if( (outReadback == OutReadback::None) &&
+        (!outFilename.empty() || !frameDumpPath.empty() || !outRtpDestinations.empty() || !outHttpBindStr.empty() ||
+         !outShmName.empty() || !outShmJpegName.empty() || !outRawFilename.empty()) )
+    {
+        std::cout << "Output needs read back, cannot use read back strategy none" << std::endl;
+        return 0;
+    }
+
+    if( (outReadback == OutReadback::PixelPackRing) && (outReadbackBufferCount == 0) )
+    {
+        std::cout << "At least one read back buffer is needed" << std::endl;
+        return 0;
+    }
+
+    // Note: YUV planes are packed 8 pixels wide and 2 rows high (see "YuvPacker.hpp")
+    if( isOutYuvEnabled && (((windowWidth % 8) != 0) || ((windowHeight % 2) != 0)) )
+    {
+        std::cout << "Invalid output size " << windowWidth << "x" << windowHeight
+                  << " for YUV output, width must be a multiple of 8 and height a multiple of 2" << std::endl;
+        return 0;
+    }
+
+    // output renditions, from the largest to the smallest
+    // Note: each rendition is scaled from the previous one, linear filtering being poor beyond a 2x ratio
+    struct OutRenditionSettings
+    {
+        uint32_t width, height;
+        std::string filename;
+    };
+    std::vector<OutRenditionSettings> outRenditionSettings;
+    for(const auto &renditionStr : outRenditionStrs)
+    {
+        OutRenditionSettings settings;
+        int filenamePos = 0;
+        if( (sscanf(renditionStr.c_str(), "%ux%u:%n", &settings.width, &settings.height, &filenamePos) != 2) ||
+            (filenamePos == 0) || (settings.width == 0) || (settings.height == 0) ||
+            (settings.width > windowWidth) || (settings.height > windowHeight) ||
+            // Note: YUV planes are packed 8 pixels wide and 2 rows high (see "YuvPacker.hpp")
+            (isOutYuvEnabled && (((settings.width % 8) != 0) || ((settings.height % 2) != 0))) )
+        {
+            std::cout << "Invalid output rendition " << renditionStr << std::endl;
+            return 0;
+        }
+        settings.filename = renditionStr.substr(filenamePos);
+        outRenditionSettings.push_back(settings);
+    }
+    std::stable_sort(outRenditionSettings.begin(), outRenditionSettings.end(),
+                     [](const OutRenditionSettings &a, const OutRenditionSettings &b) {
+                         return a.width * a.height > b.width * b.height;
+                     });
+
+    // other views of the stitched space (e.g., per-operator crops)
+    // Note: each view is rendered from the same input textures, so input streams are decoded once for all views
+    struct OutViewSettings
+    {
+        uint32_t width, height;
+        inastitch::opengl::WarpMesh::Projection projection;
+        float pan, tilt, zoom;
+        std::string sink;
+    };
+    std::vector<OutViewSettings> outViewSettings;
+    for(const auto &viewSpecStr : outViewStrs)
+    {
+        OutViewSettings settings;
+        int projectionPos = 0;
+        if( (sscanf(viewSpecStr.c_str(), "%ux%u:%n", &settings.width, &settings.height, &projectionPos) != 2) ||
+            (projectionPos == 0) || (settings.width == 0) || (settings.height == 0) ||
+            (isOutYuvEnabled && (((settings.width % 8) != 0) || ((settings.height % 2) != 0))) )
+        {
+            std::cout << "Invalid output view " << viewSpecStr << std::endl;
+            return 0;
+        }
+
+        // Note: the sink is the last field, so it can contain ':'
+        const auto viewPos = viewSpecStr.find(':', projectionPos);
+        const auto sinkPos = (viewPos == std::string::npos) ? std::string::npos : viewSpecStr.find(':', viewPos + 1);
+        if( (sinkPos == std::string::npos) || (sinkPos + 1 == viewSpecStr.size()) ||
+            !inastitch::opengl::WarpMesh::parseProjection(viewSpecStr.substr(projectionPos, viewPos - projectionPos), settings.projection) ||
+            !inastitch::opengl::VirtualView::parse(viewSpecStr.substr(viewPos + 1, sinkPos - viewPos - 1),
+                                                   settings.pan, settings.tilt, settings.zoom) )
+        {
+            std::cout << "Invalid output view " << viewSpecStr << std::endl;
+            return 0;
+        }
+        settings.sink = viewSpecStr.substr(sinkPos + 1);
+        outViewSettings.push_back(settings);
+    }
+
+    if(inTextureCount == 0)
+    {
+        std::cout << "At least one texture per input stream is needed" << std::endl;
+        return 0;
+    }
+
+    std::cout << "Input stream threads: " << inTpoolSize << std::endl;
+    std::cout << "Input stream slices: " << inSliceCount << std::endl;
+    std::cout << "Output stream threads: " << outTpoolSize << std::endl;
+    std::cout << "Output stream strips: " << outStripCount << std::endl;
+
+    GLuint glShaderProgram;
+    GLint glVirtualViewUni;
+    GLuint glCameraUniformBuffer;
+    GLFWwindow* glWindow = nullptr;
+    // Note: output is rendered to the window, or to the framebuffer of the headless context
+    std::unique_ptr<inastitch::opengl::HeadlessContext> glHeadlessContext;
+    GLuint glOutFramebuffer = 0;
 
     // OpenGL initialization
     {
-        glfwInit();
-        glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-        glWindow = glfwCreateWindow(windowWidth, windowHeight, __FILE__, NULL, NULL);
-        glfwMakeContextCurrent(glWindow);
+        if(isHeadless)
+        {
+            glHeadlessContext = std::make_unique<inastitch::opengl::HeadlessContext>(windowWidth, windowHeight);
+            glOutFramebuffer = glHeadlessContext->framebuffer();
+        }
+        else
+        {
+            glfwInit();
+            glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+            glWindow = glfwCreateWindow(windowWidth, windowHeight, __FILE__, NULL, NULL);
+            glfwMakeContextCurrent(glWindow);
+
+            // Note: file input is not real-time, so it is not paced by the display refresh rate
+            if(isFileInput)
+            {
+                glfwSwapInterval(0);
+            }
+        }
 
         printf("GL_VERSION  : %s\n", glGetString(GL_VERSION) );
         printf("GL_RENDERER : %s\n", glGetString(GL_RENDERER) );
 
+        // Note: all uniforms and vertex arrays are set up once, only camera and view uniforms are updated when they change
         glShaderProgram = inastitch::opengl::helper::getShaderProgram(vertexShaderSource, fragmentShaderSource);
-        GL_CHECK( glShaderPositionAttrib = glGetAttribLocation(glShaderProgram, "position") );
-        GL_CHECK( glShaderTexCoordAttrib = glGetAttribLocation(glShaderProgram, "texCoord") );
+
+        // Y plane (or RGBA) is on texture unit 0, U and V planes on unit 1 and 2
+        GL_CHECK( glUseProgram(glShaderProgram) );
+        GL_CHECK( glUniform1i(glGetUniformLocation(glShaderProgram, "textureY"), 0) );
+        GL_CHECK( glUniform1i(glGetUniformLocation(glShaderProgram, "textureU"), 1) );
+        GL_CHECK( glUniform1i(glGetUniformLocation(glShaderProgram, "textureV"), 2) );
+        GL_CHECK( glUniform1i(glGetUniformLocation(glShaderProgram, "isYuv"), isYuvEnabled) );
+        GL_CHECK( glUseProgram(0) );
+        glVirtualViewUni = glGetUniformLocation(glShaderProgram, "virtualView");
+
+        const GLuint cameraUniformBinding = 0;
+        GL_CHECK( glUniformBlockBinding(glShaderProgram, glGetUniformBlockIndex(glShaderProgram, "Cameras"), cameraUniformBinding) );
+        GL_CHECK( glGenBuffers(1, &glCameraUniformBuffer) );
+        GL_CHECK( glBindBuffer(GL_UNIFORM_BUFFER, glCameraUniformBuffer) );
+        GL_CHECK( glBufferData(GL_UNIFORM_BUFFER, maxInputStreamCount * sizeof(CameraUniforms), nullptr, GL_DYNAMIC_DRAW) );
+        GL_CHECK( glBindBuffer(GL_UNIFORM_BUFFER, 0) );
+        GL_CHECK( glBindBufferBase(GL_UNIFORM_BUFFER, cameraUniformBinding, glCameraUniformBuffer) );
 
         GL_CHECK( glEnable(GL_DEPTH_TEST) );
         GL_CHECK( glClearColor(0.0f, 0.0f, 0.0f, 1.0f) );
         GL_CHECK( glViewport(0, 0, windowWidth, windowHeight) );
+    }
+
+    // video textures, one layer per input stream
+    // Note: frame N+1 is uploaded to other textures than the ones frame N is drawn from
+    auto inTextureRing = std::make_unique<inastitch::opengl::TextureRing>(inTextureCount, cameraCount, isYuvEnabled,
+                                                                      inStreamWidth, inStreamHeight);
+    if(isYuvEnabled)
+    {
+        // plane rows are not 4-byte aligned
+        GL_CHECK( glPixelStorei(GL_UNPACK_ALIGNMENT, 1) );
+    }
 
-        GL_CHECK( glGenBuffers(1, &glVextexBufferObject) );
-        GL_CHECK( glBindBuffer(GL_ARRAY_BUFFER, glVextexBufferObject) );
-        GL_CHECK( glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW) );
-        GL_CHECK( glVertexAttribPointer(glShaderPositionAttrib,  2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (GLvoid*)0) );
-        GL_CHECK( glEnableVertexAttribArray(glShaderPositionAttrib) );
-        GL_CHECK( glVertexAttribPointer(glShaderTexCoordAttrib, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (GLvoid*)(2 * sizeof(float))) );
-        GL_CHECK( glEnableVertexAttribArray(glShaderTexCoordAttrib) );
-        GL_CHECK( glBindBuffer(GL_ARRAY_BUFFER, 0) );
-    }
-
-    // video texture
-    unsigned int textureWidth = inStreamWidth, textureHeight = inStreamHeight;
-    GLuint texture0;
-    GL_CHECK( glGenTextures(1, &texture0) );
-    GL_CHECK( glBindTexture(GL_TEXTURE_2D, texture0) ); // bind
-    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT) );
-    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT) );
-    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST) );
-    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST) );
-    GL_CHECK( glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, textureWidth, textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr) );
-    GL_CHECK( glBindTexture(GL_TEXTURE_2D, 0) );        // unbind
-
-    uint32_t overlayWidth = windowWidth/2, overlayHeight = windowHeight/2;
-    inastitch::opengl::helper::Overlay overlayHelper(overlayWidth, overlayHeight);
-
-    // overlay texture
-    unsigned int textureOverlay;
-    GL_CHECK( glGenTextures(1, &textureOverlay) );
-    GL_CHECK( glBindTexture(GL_TEXTURE_2D, textureOverlay) );  // bind
-    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT) );
-    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT) );
-    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST) );
-    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST) );
-    GL_CHECK( glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, overlayWidth, overlayHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr) );
-    GL_CHECK( glBindTexture(GL_TEXTURE_2D, 0) );  // unbind
+    // Note: text positions are in half output resolution
+    auto textOverlay = std::make_unique<inastitch::opengl::TextOverlay>(windowWidth/2, windowHeight/2);
 
     const auto pixelSize = 4; // RGBA
     const auto pboBufferSize = windowWidth * windowHeight * pixelSize;
-#if USE_OPENGL_PBO
-    // PBO
-    const auto pboCount = 2;
-    unsigned int pboIds[pboCount];
-    glGenBuffers(pboCount, pboIds);
-    for(int i=0; i<pboCount; i++)
+
+    // output color conversion
+    std::unique_ptr<inastitch::opengl::YuvPacker> outYuvPacker;
+    if(isOutYuvEnabled)
     {
-         GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, pboIds[i]) );
-         GL_CHECK( glBufferData(GL_PIXEL_PACK_BUFFER, pboBufferSize, nullptr, GL_STREAM_READ ) );
+        outYuvPacker = std::make_unique<inastitch::opengl::YuvPacker>(windowWidth, windowHeight);
     }
-#endif
+    const auto outReadbackSize = outYuvPacker ? outYuvPacker->bufferSize() : pboBufferSize;
 
-    const glm::mat4 identMat4 = glm::mat4(1.0f);
-    const glm::mat4 initialViewMat = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -2.0f));
-    glm::mat4 modelMat[3] = {identMat4, identMat4, identMat4};
-    glm::mat4 viewMat[3] =  {initialViewMat, initialViewMat, initialViewMat};
-    glm::mat4 projMat = glm::perspective(glm::radians(45.0f), static_cast<float>(windowWidth)/windowHeight, 0.1f, 100.0f);
+    // Note: outputs hold mapped frames, so the ring is declared before them (i.e., destroyed after them)
+    std::unique_ptr<inastitch::opengl::PixelPackRing> outPixelPackRing;
+    if(outReadback == OutReadback::PixelPackRing)
+    {
+        outPixelPackRing = std::make_unique<inastitch::opengl::PixelPackRing>(outReadbackBufferCount, outReadbackSize);
+    }
 
-    const glm::mat3 identMat3 = glm::mat3(1.0f);
-    glm::mat3 texWarpMat[3] = {identMat3, identMat3, identMat3};
+    // read back output pixels of the current frame
+    // Note: 'buffer' is an offset when a GL_PIXEL_PACK_BUFFER is bound
+    auto readOutputPixels = [&](uint8_t *buffer)
+    {
+        if(outYuvPacker)
+        {
+            outYuvPacker->pack();
+            outYuvPacker->readPixels(buffer);
+        }
+        else
+        {
+            GL_CHECK( glReadPixels(0, 0, windowWidth, windowHeight, GL_RGBA, GL_UNSIGNED_BYTE, buffer) );
+        }
+    };
 
-    const auto outStreamMaxRgbBufferSize = windowWidth * windowHeight * 3;
-    inastitch::jpeg::Encoder rtpJpegEncoder(outStreamMaxRgbBufferSize);
-    // Note: JPEG data should be smaller than raw RGB data
+    // Note: mesh is baked once, per-pixel cost is the texture fetch only
+    const uint32_t warpMeshGridWidth = 64, warpMeshGridHeight = 48;
+    auto warpMesh = std::make_unique<inastitch::opengl::WarpMesh>(cameraCount, warpMeshGridWidth, warpMeshGridHeight);
+    for(uint32_t camIdx=0; camIdx<cameraCount; camIdx++)
+    {
+        warpMesh->bake(camIdx, projMat, viewMat[camIdx] * modelMat[camIdx], texWarpMat[camIdx],
+                      texLens[camIdx].get(), outProjection,
+                      glm::vec2(topRightX, topRightY), glm::vec2(bottomLeftX, bottomLeftY));
+    }
+    warpMesh->upload();
 
-    // read matrix settings from JSON file
+    // other views are rendered to their own framebuffer, each one has its own mesh, readback, encoder and sink
+    struct OutView
     {
-        const tao::json::value json = tao::json::from_file(inMatrixJsonFilename);
+        std::unique_ptr<inastitch::opengl::RenditionTarget> target;
+        std::unique_ptr<inastitch::opengl::WarpMesh> warpMesh;
+        inastitch::opengl::VirtualView virtualView;
+        std::unique_ptr<inastitch::jpeg::EncoderPipeline> encoderPipeline;
+        // Note: settings of the frames being read back, in order
+        std::deque<inastitch::jpeg::EncoderPipeline::FrameInfo> pendingFrameInfos;
+        std::unique_ptr<inastitch::jpeg::RtpJpegSender> rtpJpegSender;
+        std::ofstream jpegFile;
+        std::ofstream ptsFile;
+    };
+    std::vector<std::unique_ptr<OutView>> outViews;
+    // Note: views split the encoder threads, rather than each one having as many as the output
+    const uint32_t outViewWorkerCount = outViewSettings.empty() ? 0 :
+        std::max(1u, static_cast<uint32_t>(outViewTpoolSize / outViewSettings.size()));
+    for(const auto &settings : outViewSettings)
+    {
+        auto view = std::make_unique<OutView>();
+        auto &viewRef = *view;
+        view->target = std::make_unique<inastitch::opengl::RenditionTarget>(settings.width, settings.height, isOutYuvEnabled, true);
+        view->warpMesh = std::make_unique<inastitch::opengl::WarpMesh>(cameraCount, warpMeshGridWidth, warpMeshGridHeight);
+        for(uint32_t camIdx=0; camIdx<cameraCount; camIdx++)
+        {
+            view->warpMesh->bake(camIdx, projMat, viewMat[camIdx] * modelMat[camIdx], texWarpMat[camIdx],
+                                 texLens[camIdx].get(), settings.projection,
+                                 glm::vec2(topRightX, topRightY), glm::vec2(bottomLeftX, bottomLeftY));
+        }
+        view->warpMesh->upload();
+        view->virtualView.setAspectRatio(static_cast<float>(settings.width * windowHeight) / (settings.height * windowWidth));
+        view->virtualView.set(settings.pan, settings.tilt, settings.zoom);
 
-        using namespace inastitch::json;
-        jsonToGlmMat4(json.at("texture0").as<std::vector<float>>("model"), modelMat[0]);
-        jsonToGlmMat4(json.at("texture0").as<std::vector<float>>("view"), viewMat[0]);
-        jsonToGlmMat3(json.at("texture0").as<std::vector<float>>("warp"), texWarpMat[0]);
+        const std::string rtpScheme = "rtp://";
+        if(settings.sink.compare(0, rtpScheme.size(), rtpScheme) == 0)
+        {
+            const std::vector<std::string> rtpDestinations = { settings.sink.substr(rtpScheme.size()) };
+            view->rtpJpegSender = std::make_unique<inastitch::jpeg::RtpJpegSender>(rtpDestinations, outRtpMaxBitrate);
+        }
+        else
+        {
+            view->jpegFile = std::ofstream(settings.sink, std::ios::binary);
+            view->ptsFile = std::ofstream(settings.sink + ".pts");
+        }
 
-        jsonToGlmMat4(json.at("texture1").as<std::vector<float>>("model"), modelMat[1]);
-        jsonToGlmMat4(json.at("texture1").as<std::vector<float>>("view"), viewMat[1]);
-        jsonToGlmMat3(json.at("texture1").as<std::vector<float>>("warp"), texWarpMat[1]);
+        view->encoderPipeline = std::make_unique<inastitch::jpeg::EncoderPipeline>(
+            outViewWorkerCount, 1, outQueueSize, view->target->bufferSize(), settings.width * settings.height * 3,
+            [&viewRef](const inastitch::jpeg::EncoderPipeline::EncodedFrame &encodedFrame)
+            {
+                const auto &info = encodedFrame.info;
+                if(viewRef.rtpJpegSender)
+                {
+                    if(!viewRef.rtpJpegSender->sendFrame(encodedFrame.jpegData->data(), encodedFrame.jpegData->size(), info.absTime)) {
+                        std::cerr << "Error: view frame " << info.frameIdx << " cannot be sent as RTP/JPEG" << std::endl;
+                    }
+                }
+                else
+                {
+                    viewRef.jpegFile.write(reinterpret_cast<const char*>(encodedFrame.jpegData->data()), encodedFrame.jpegData->size());
+                    viewRef.ptsFile << info.absTime << " " << info.relTime << " " << info.offTime << std::endl;
+                }
+            }
+        );
+        outViews.push_back(std::move(view));
+    }
 
-        jsonToGlmMat4(json.at("texture2").as<std::vector<float>>("model"), modelMat[2]);
-        jsonToGlmMat4(json.at("texture2").as<std::vector<float>>("view"), viewMat[2]);
-        jsonToGlmMat3(json.at("texture2").as<std::vector<float>>("warp"), texWarpMat[2]);
+    // camera uniforms only change when a stream gets its first frame or its decoded size changes
+    std::vector<CameraUniforms> cameraUniforms(cameraCount), lastCameraUniforms(cameraCount);
+    for(uint32_t camIdx=0; camIdx<cameraCount; camIdx++)
+    {
+        auto &uniforms = cameraUniforms[camIdx];
+        std::fill(std::begin(uniforms.texScale), std::end(uniforms.texScale), 1.0f);
+        std::fill(std::begin(uniforms.gain), std::end(uniforms.gain), 1.0f);
+        uniforms.visible = 1.0f;
+        std::fill(std::begin(uniforms.padding), std::end(uniforms.padding), 0.0f);
+    }
+    // Note: forces the first update
+    memset(lastCameraUniforms.data(), 0xFF, lastCameraUniforms.size() * sizeof(CameraUniforms));
+
+    // exposure and color compensation, from low resolution statistics of the output every few frames
+    // Note: statistics are rendered with the virtual camera, i.e., only from decoded texels (see "in-crop-decode")
+    std::unique_ptr<inastitch::opengl::GainCompensator> gainCompensator;
+    if(isGainCompensationEnabled)
+    {
+        const uint32_t gainStatsWidth = 128;
+        const uint32_t gainStatsHeight = std::max(1u, gainStatsWidth * windowHeight / windowWidth);
+        const uint32_t gainFrameInterval = 8;
+        gainCompensator = std::make_unique<inastitch::opengl::GainCompensator>(
+            cameraCount, gainStatsWidth, gainStatsHeight, gainFrameInterval);
     }
 
     const auto inStreamMaxRgbBufferSize = inStreamWidth * inStreamHeight * 4; // RGBA format
 
-    std::unique_ptr<GenericInputStreamContext> inStreamContext0;
-    std::unique_ptr<GenericInputStreamContext> inStreamContext1;
-    std::unique_ptr<GenericInputStreamContext> inStreamContext2;
-    if(isFileInput)
+    // pixel unpack buffers that input frames are decoded into
+    // Note: one buffer being decoded into, one being uploaded and one spare to avoid waiting
+    const auto pixelUnpackBufferCount = 3;
+    std::vector<std::unique_ptr<inastitch::opengl::PixelUnpackRing>> inPixelUnpackRings(cameraCount);
+    if(isPboUploadEnabled)
     {
-        inStreamContext0 = std::make_unique<InputStreamContext<inastitch::jpeg::MjpegParser>>(inStreamMaxRgbBufferSize, inFilename0);
-        inStreamContext1 = std::make_unique<InputStreamContext<inastitch::jpeg::MjpegParser>>(inStreamMaxRgbBufferSize, inFilename1);
-        inStreamContext2 = std::make_unique<InputStreamContext<inastitch::jpeg::MjpegParser>>(inStreamMaxRgbBufferSize, inFilename2);
+        for(auto &inPixelUnpackRing : inPixelUnpackRings)
+        {
+            inPixelUnpackRing = std::make_unique<inastitch::opengl::PixelUnpackRing>(pixelUnpackBufferCount, inStreamMaxRgbBufferSize);
+        }
     }
-    else
+
+    // decoders are shared by all input streams
+    // Note: slices use as many extra threads as input stream threads, those are idle when a single stream is busy
+    const uint32_t sliceThreadCount = (inSliceCount > 1) ? inTpoolSize : 0;
+    inastitch::jpeg::DecoderPool decoderPool(inTpoolSize, sliceThreadCount);
+
+    std::vector<std::unique_ptr<GenericInputStreamContext>> inStreamContexts;
+    for(uint32_t camIdx=0; camIdx<cameraCount; camIdx++)
+    {
+        if(isFileInput)
+        {
+            inStreamContexts.push_back(std::make_unique<InputStreamContext<inastitch::jpeg::MjpegParser>>(
+                inStreamMaxRgbBufferSize, inFilenames[camIdx], decoderPool));
+        }
+        else
+        {
+            inStreamContexts.push_back(std::make_unique<InputStreamContext<inastitch::jpeg::RtpJpegParser>>(
+                inStreamMaxRgbBufferSize, inSocketPorts[camIdx], decoderPool));
+        }
+    }
+
+    for(auto &inStreamCtx : inStreamContexts)
     {
-        inStreamContext0 = std::make_unique<InputStreamContext<inastitch::jpeg::RtpJpegParser>>(inStreamMaxRgbBufferSize, inSocketPort0);
-        inStreamContext1 = std::make_unique<InputStreamContext<inastitch::jpeg::RtpJpegParser>>(inStreamMaxRgbBufferSize, inSocketPort1);
-        inStreamContext2 = std::make_unique<InputStreamContext<inastitch::jpeg::RtpJpegParser>>(inStreamMaxRgbBufferSize, inSocketPort2);
+        inStreamCtx->decodeSettings.isYuv = isYuvEnabled;
+        inStreamCtx->decodeSettings.maxSliceCount = inSliceCount;
+    }
+
+    // choose input decoding resolution and region from the on-screen footprint of each texture,
+    // and skip the input streams that are out of view
+    // Note: called again when the view changes, between two frames (i.e., when no decoding is running).
+    //       With other views, a stream is decoded at the finest scale and over the union of the regions they need.
+    // Note: not a vector of bool, since decoding threads read it concurrently
+    std::vector<uint8_t> isCameraInView(cameraCount);
+    auto updateView = [&]()
+    {
+        std::cout << "View: " << virtualView.pan() << "," << virtualView.tilt()
+                  << " zoom " << virtualView.zoom() << std::endl;
+
+        GL_CHECK( glUseProgram(glShaderProgram) );
+        GL_CHECK( glUniformMatrix4fv(glVirtualViewUni, 1, GL_FALSE, glm::value_ptr(virtualView.matrix())) );
+        GL_CHECK( glUseProgram(0) );
+
+        struct RenderView
+        {
+            const inastitch::opengl::WarpMesh *warpMesh;
+            const inastitch::opengl::VirtualView *virtualView;
+            uint32_t width, height;
+        };
+        std::vector<RenderView> renderViews = { { warpMesh.get(), &virtualView, windowWidth, windowHeight } };
+        for(const auto &view : outViews)
+        {
+            renderViews.push_back({ view->warpMesh.get(), &view->virtualView, view->target->width(), view->target->height() });
+        }
+
+        // Texture coordinates from the shader are wrapped (GL_REPEAT) into the frame.
+        // A range that crosses the frame border is not cropped.
+        auto wrapRange = [](float texMin, float texMax)
+        {
+            const auto offset = std::floor(texMin);
+            if(texMax - offset > 1.0f) {
+                return std::make_tuple(0.0f, 1.0f);
+            }
+            return std::make_tuple(texMin - offset, texMax - offset);
+        };
+
+        for(uint32_t camIdx=0; camIdx<cameraCount; camIdx++)
+        {
+            isCameraInView[camIdx] = false;
+            float maxPixelPerTexel = 0.0f;
+            bool isCropVisible = false;
+            float cropLeft = 1.0f, cropTop = 1.0f, cropRight = 0.0f, cropBottom = 0.0f;
+
+            for(const auto &renderView : renderViews)
+            {
+                glm::vec2 ndcMin, ndcMax;
+                renderView.warpMesh->bounds(camIdx, ndcMin, ndcMax);
+                if(!renderView.virtualView->isVisible(ndcMin, ndcMax))
+                {
+                    continue;
+                }
+                isCameraInView[camIdx] = true;
+
+                if(!isScaledDecodeEnabled && !isCropDecodeEnabled)
+                {
+                    continue;
+                }
+
+                // Note: from the baked mesh, so that lens distortion and output projection are accounted for
+                const auto footprint = renderView.warpMesh->footprint(
+                    camIdx, renderView.virtualView->matrix(),
+                    inStreamWidth, inStreamHeight,
+                    renderView.width, renderView.height
+                );
+                maxPixelPerTexel = std::max(maxPixelPerTexel, footprint.maxPixelPerTexel);
+
+                if(footprint.isVisible)
+                {
+                    const auto [ viewCropLeft, viewCropRight ] = wrapRange(footprint.texMin.x, footprint.texMax.x);
+                    const auto [ viewCropTop, viewCropBottom ] = wrapRange(footprint.texMin.y, footprint.texMax.y);
+                    cropLeft = std::min(cropLeft, viewCropLeft);
+                    cropTop = std::min(cropTop, viewCropTop);
+                    cropRight = std::max(cropRight, viewCropRight);
+                    cropBottom = std::max(cropBottom, viewCropBottom);
+                    isCropVisible = true;
+                }
+            }
+
+            if(!isCameraInView[camIdx])
+            {
+                std::cout << "Input " << camIdx << ": out of view" << std::endl;
+                continue;
+            }
+
+            if(isScaledDecodeEnabled)
+            {
+                // Note: a texture that is not visible at all is decoded at the smallest scale
+                const auto [ scalingNum, scalingDenom ] = inastitch::jpeg::Decoder::getBestScalingFactor(maxPixelPerTexel);
+                inStreamContexts[camIdx]->decodeSettings.scalingNum = scalingNum;
+                inStreamContexts[camIdx]->decodeSettings.scalingDenom = scalingDenom;
+
+                std::cout << "Input " << camIdx << ": "
+                          << maxPixelPerTexel << " pixel/texel, "
+                          << "decode scale " << scalingNum << "/" << scalingDenom << std::endl;
+            }
+
+            if(isCropDecodeEnabled)
+            {
+                // Note: when no sampled texel is found, the whole frame is decoded rather than keeping a stale region
+                if(!isCropVisible)
+                {
+                    cropLeft = cropTop = 0.0f;
+                    cropRight = cropBottom = 1.0f;
+                }
+
+                auto &decodeSettings = inStreamContexts[camIdx]->decodeSettings;
+                decodeSettings.cropLeft = cropLeft;
+                decodeSettings.cropTop = cropTop;
+                decodeSettings.cropRight = cropRight;
+                decodeSettings.cropBottom = cropBottom;
+
+                std::cout << "Input " << camIdx << ": "
+                          << "decode region " << cropLeft << "," << cropTop
+                          << " to " << cropRight << "," << cropBottom << std::endl;
+            }
+        }
+    };
+    updateView();
+
+    // runtime view control from stdin, one "PAN TILT ZOOM" line per change
+    // Note: the reading thread is never joined (i.e., it may be blocked on stdin), so it shares the state by value
+    struct ViewRequest
+    {
+        std::mutex mutex;
+        bool isPending = false;
+        float pan, tilt, zoom;
+    };
+    const auto viewRequest = std::make_shared<ViewRequest>();
+    if(isViewStdinEnabled)
+    {
+        std::thread([viewRequest]() {
+            std::string line;
+            while(std::getline(std::cin, line))
+            {
+                float pan, tilt, zoom;
+                if(!inastitch::opengl::VirtualView::parse(line, pan, tilt, zoom))
+                {
+                    std::cout << "Invalid view " << line << std::endl;
+                    continue;
+                }
+
+                std::lock_guard<std::mutex> lock(viewRequest->mutex);
+                viewRequest->pan = pan;
+                viewRequest->tilt = tilt;
+                viewRequest->zoom = zoom;
+                viewRequest->isPending = true;
+            }
+        }).detach();
     }
 
     // parse first frames before entering the loop
+    for(auto &inStreamCtx : inStreamContexts)
     {
-        inStreamContext0->getFrame(0);
-        inStreamContext1->getFrame(0);
-        inStreamContext2->getFrame(0);
+        inStreamCtx->getFrame(0);
     }
 
     // prepare output file
     auto outJpegFile = std::ofstream(outFilename, std::ios::binary);
     auto outPtsFile = std::ofstream(outFilename + ".pts");
 
+    // prepare shared memory outputs
+    // Note: consumers read the latest frame in place, see "SharedMemoryRing.hpp"
+    std::unique_ptr<inastitch::shm::SharedMemoryRing> outRawShmRing, outJpegShmRing;
+    if(!outShmName.empty())
+    {
+        outRawShmRing = std::make_unique<inastitch::shm::SharedMemoryRing>(outShmName, outShmSlotCount, outReadbackSize);
+    }
+    if(!outShmJpegName.empty())
+    {
+        outJpegShmRing = std::make_unique<inastitch::shm::SharedMemoryRing>(outShmJpegName, outShmSlotCount, outStreamMaxRgbBufferSize);
+    }
+
+    // prepare raw video output
+    // Note: frames are shared with the encoder when both are enabled, see below
+    std::unique_ptr<inastitch::video::RawVideoWriter> outRawWriter;
+    if(!outRawFilename.empty())
+    {
+        outRawWriter = std::make_unique<inastitch::video::RawVideoWriter>(
+            outRawFilename, outRawFormat, windowWidth, windowHeight, outRawFrameRate, outQueueSize, outReadbackSize);
+    }
+
+    // prepare output stream
+    std::unique_ptr<inastitch::jpeg::RtpJpegSender> outRtpJpegSender;
+    if(!outRtpDestinations.empty())
+    {
+        outRtpJpegSender = std::make_unique<inastitch::jpeg::RtpJpegSender>(outRtpDestinations, outRtpMaxBitrate);
+    }
+
+    std::unique_ptr<inastitch::jpeg::MjpegHttpServer> outHttpServer;
+    if(!outHttpBindStr.empty())
+    {
+        outHttpServer = std::make_unique<inastitch::jpeg::MjpegHttpServer>(outHttpBindStr, outHttpMaxClientCount);
+    }
+
+    // output JPEG quality follows the target size or bitrate
+    std::unique_ptr<inastitch::jpeg::RateController> outRateController;
+    if( (outTargetFrameSize > 0) || (outTargetBitrate > 0) )
+    {
+        outRateController = std::make_unique<inastitch::jpeg::RateController>(outTargetFrameSize, outTargetBitrate, isOutReencodeEnabled);
+    }
+
+    // output frames are encoded in parallel, then written in order
+    const bool isOutEncodeEnabled = !outFilename.empty() || !frameDumpPath.empty() || outRtpJpegSender || outJpegShmRing || outHttpServer;
+    // Note: only allocated (frames and threads) when an output needs JPEG frames
+    std::unique_ptr<inastitch::jpeg::EncoderPipeline> outEncoderPipeline;
+    if(isOutEncodeEnabled)
+    {
+        outEncoderPipeline = std::make_unique<inastitch::jpeg::EncoderPipeline>(
+            outTpoolSize, outStripCount, outQueueSize, pboBufferSize, outStreamMaxRgbBufferSize,
+            [&](const inastitch::jpeg::EncoderPipeline::EncodedFrame &encodedFrame)
+            {
+                const auto &info = encodedFrame.info;
+                const auto jpegData = reinterpret_cast<const char*>(encodedFrame.jpegData->data());
+                const auto jpegSize = encodedFrame.jpegData->size();
+
+                const std::string ptsStr = std::to_string(info.absTime) + " "
+                                           + std::to_string(info.relTime) + " "
+                                           + std::to_string(info.offTime);
+
+                if(isStatsEnabled && outRateController)
+                {
+                    std::cout << "[" << info.frameIdx << "] outQuality:" << encodedFrame.quality
+                              << ", outSize:" << jpegSize
+                              << ", outEncodeCount:" << encodedFrame.encodeCount
+                              << ", outBitrate:" << outRateController->getBitrate() / 1000 << "kbit/s"
+                              << std::endl;
+                }
+
+                if(outJpegShmRing && (jpegSize <= outJpegShmRing->slotSize()))
+                {
+                    memcpy(outJpegShmRing->beginWrite(), jpegData, jpegSize);
+                    outJpegShmRing->endWrite(inastitch::shm::FrameFormat::Jpeg, windowWidth, windowHeight, jpegSize,
+                                             info.frameIdx, info.absTime, info.relTime, info.offTime);
+                }
+
+                if(outRtpJpegSender)
+                {
+                    // Note: sending is paced, so this can take up to a frame time
+                    if(!outRtpJpegSender->sendFrame(encodedFrame.jpegData->data(), jpegSize, info.absTime)) {
+                        std::cerr << "Error: output frame " << info.frameIdx << " cannot be sent as RTP/JPEG" << std::endl;
+                    }
+                }
+
+                if(outHttpServer)
+                {
+                    // Note: buffer is shared by all clients, none of them can stall the writer
+                    outHttpServer->publishFrame(encodedFrame.jpegData, info.absTime);
+                }
+
+                if(!outFilename.empty())
+                {
+                    // append to output MJPEG
+                    outJpegFile.write(jpegData, jpegSize);
+
+                    // append to output PTS
+                    outPtsFile << ptsStr << std::endl;
+                }
+
+                if(!frameDumpPath.empty())
+                {
+                    auto jpegFile = std::fstream(frameDumpPath + std::to_string(info.frameIdx) + "out.jpg", std::ios::out | std::ios::binary);
+                    jpegFile.write(jpegData, jpegSize);
+                    jpegFile.close();
+
+                    auto ptsFile = std::fstream(frameDumpPath + std::to_string(info.frameIdx) + "out.jpg" + ".pts", std::ios::out);
+                    ptsFile << ptsStr;
+                    ptsFile.close();
+                }
+            },
+            outRateController.get()
+        );
+    }
+
+    // output renditions are scaled on the GPU, each one has its own readback, encoder and output files
+    struct OutRendition
+    {
+        std::unique_ptr<inastitch::opengl::RenditionTarget> target;
+        std::unique_ptr<inastitch::jpeg::EncoderPipeline> encoderPipeline;
+        // Note: settings of the frames being read back, in order
+        std::deque<inastitch::jpeg::EncoderPipeline::FrameInfo> pendingFrameInfos;
+        std::ofstream jpegFile;
+        std::ofstream ptsFile;
+    };
+    std::vector<std::unique_ptr<OutRendition>> outRenditions;
+    for(const auto &settings : outRenditionSettings)
+    {
+        auto rendition = std::make_unique<OutRendition>();
+        auto &renditionRef = *rendition;
+        rendition->target = std::make_unique<inastitch::opengl::RenditionTarget>(settings.width, settings.height, isOutYuvEnabled);
+        rendition->jpegFile = std::ofstream(settings.filename, std::ios::binary);
+        rendition->ptsFile = std::ofstream(settings.filename + ".pts");
+        // Note: renditions are smaller than the output, one encoder thread each
+        rendition->encoderPipeline = std::make_unique<inastitch::jpeg::EncoderPipeline>(
+            1, 1, outQueueSize, rendition->target->bufferSize(), settings.width * settings.height * 3,
+            [&renditionRef](const inastitch::jpeg::EncoderPipeline::EncodedFrame &encodedFrame)
+            {
+                const auto &info = encodedFrame.info;
+                renditionRef.jpegFile.write(reinterpret_cast<const char*>(encodedFrame.jpegData->data()), encodedFrame.jpegData->size());
+                renditionRef.ptsFile << info.absTime << " " << info.relTime << " " << info.offTime << std::endl;
+            }
+        );
+        outRenditions.push_back(std::move(rendition));
+    }
+
+    // output frame settings, read back now or handed over later (see 'OutReadback')
+    struct OutFrameInfo
+    {
+        bool isDumped;
+        uint64_t frameIdx;
+        uint64_t absTime;
+        uint64_t relTime;
+        uint64_t offTime;
+    };
+    std::deque<OutFrameInfo> outPendingFrameInfos;
+
+    // Note: 'pixels' are either in 'outFrame' or already in 'outShmBuffer'
+    auto publishOutFrame = [&](std::shared_ptr<inastitch::jpeg::Frame> outFrame, const uint8_t *pixels,
+                               uint8_t *outShmBuffer, const OutFrameInfo &info)
+    {
+        if(outShmBuffer)
+        {
+            if(pixels != outShmBuffer)
+            {
+                memcpy(outShmBuffer, pixels, outReadbackSize);
+            }
+            const auto outShmFormat = isOutYuvEnabled ? inastitch::shm::FrameFormat::I420 : inastitch::shm::FrameFormat::Rgba;
+            outRawShmRing->endWrite(outShmFormat, windowWidth, windowHeight, outReadbackSize,
+                                    info.frameIdx, info.absTime, info.relTime, info.offTime);
+        }
+
+        if(outFrame)
+        {
+            outFrame->width = windowWidth;
+            outFrame->height = windowHeight;
+            outFrame->fullWidth = windowWidth;
+            outFrame->fullHeight = windowHeight;
+            outFrame->isYuv = isOutYuvEnabled;
+            if(outYuvPacker)
+            {
+                for(uint32_t planeIdx=0; planeIdx<inastitch::opengl::YuvPacker::planeCount; planeIdx++)
+                {
+                    outFrame->yuvPlanes[planeIdx] = outFrame->buffer + outYuvPacker->planeOffset(planeIdx);
+                    outFrame->yuvPlaneWidths[planeIdx] = outYuvPacker->planeWidth(planeIdx);
+                    outFrame->yuvPlaneHeights[planeIdx] = outYuvPacker->planeHeight(planeIdx);
+                }
+            }
+
+            if(outRawWriter)
+            {
+                // Note: frame is only read, so it is shared rather than copied
+                inastitch::video::RawVideoWriter::FrameInfo outRawFrameInfo;
+                outRawFrameInfo.absTime = info.absTime;
+                outRawFrameInfo.relTime = info.relTime;
+                outRawFrameInfo.offTime = info.offTime;
+                outRawWriter->push(outFrame, outRawFrameInfo, isFileInput);
+            }
+
+            if(isOutEncodeEnabled)
+            {
+                inastitch::jpeg::EncoderPipeline::FrameInfo outFrameInfo;
+                outFrameInfo.frameIdx = info.frameIdx;
+                outFrameInfo.absTime = info.absTime;
+                outFrameInfo.relTime = info.relTime;
+                outFrameInfo.offTime = info.offTime;
+                outEncoderPipeline->push(std::move(outFrame), outFrameInfo);
+            }
+        }
+    };
+
+    // hands over the mapped frames of the read back ring
+    // Note: a frame that is not dumped is only published to shared memory
+    auto publishMappedOutFrames = [&](bool isWaiting)
+    {
+        while(auto mappedFrame = outPixelPackRing->map(isWaiting))
+        {
+            const auto info = outPendingFrameInfos.front();
+            outPendingFrameInfos.pop_front();
+
+            uint8_t* const outShmBuffer = outRawShmRing ? outRawShmRing->beginWrite() : nullptr;
+            const bool isHandedOver = info.isDumped && (isOutEncodeEnabled || outRawWriter);
+            publishOutFrame(isHandedOver ? mappedFrame : nullptr, mappedFrame->buffer, outShmBuffer, info);
+        }
+    };
+
+    // hands over the oldest readback of a rendition or other view to its encoder
+    // Note: file input is not real-time, so wait for the encoder rather than dropping frames
+    auto publishTargetFrame = [&](inastitch::opengl::RenditionTarget &target, inastitch::jpeg::EncoderPipeline &encoderPipeline,
+                                  std::deque<inastitch::jpeg::EncoderPipeline::FrameInfo> &pendingFrameInfos)
+    {
+        const auto info = pendingFrameInfos.front();
+        pendingFrameInfos.pop_front();
+
+        auto targetFrame = encoderPipeline.acquireFrame(isFileInput);
+        target.copyPixels(targetFrame ? targetFrame->buffer : nullptr);
+        if(targetFrame)
+        {
+            targetFrame->width = targetFrame->fullWidth = target.width();
+            targetFrame->height = targetFrame->fullHeight = target.height();
+            targetFrame->isYuv = (target.yuvPacker() != nullptr);
+            if(target.yuvPacker())
+            {
+                for(uint32_t planeIdx=0; planeIdx<inastitch::opengl::YuvPacker::planeCount; planeIdx++)
+                {
+                    targetFrame->yuvPlanes[planeIdx] = targetFrame->buffer + target.yuvPacker()->planeOffset(planeIdx);
+                    targetFrame->yuvPlaneWidths[planeIdx] = target.yuvPacker()->planeWidth(planeIdx);
+                    targetFrame->yuvPlaneHeights[planeIdx] = target.yuvPacker()->planeHeight(planeIdx);
+                }
+            }
+            encoderPipeline.push(std::move(targetFrame), info);
+        }
+    };
+
     bool isFirstFrame = true;
     uint64_t frameCount = 0;
     uint64_t frameRelTime = 0;
@@ -440,34 +1476,63 @@ int main(int argc, char** argv)
     const auto renderTimeStart = std::chrono::high_resolution_clock::now();
 
     // This is the rendering loop
-    while(!glfwWindowShouldClose(glWindow) && (frameDumpCount < maxDumpFrameCount))
+    while((!glWindow || !glfwWindowShouldClose(glWindow)) && (frameDumpCount < maxDumpFrameCount))
     {
         const auto frameT1 = std::chrono::high_resolution_clock::now();
 
-        uint64_t frameAbsTime = 0;
+        // view changes apply to the whole frame, from decoding to rendering
         {
-            // min of 3 input frame timestamps
-            frameAbsTime = std::min(inStreamContext0->absTime, std::min(inStreamContext1->absTime, inStreamContext2->absTime));
-            inStreamContext0->timeDelay = inStreamContext0->absTime - frameAbsTime;
-            inStreamContext1->timeDelay = inStreamContext1->absTime - frameAbsTime;
-            inStreamContext2->timeDelay = inStreamContext2->absTime - frameAbsTime;
-
-            bool eofContext0 = false, eofContext1 = false, eofContext2 = false;
-
-            if(inStreamContext0->timeDelay < maxDelay)
+            const float lastPan = virtualView.pan(), lastTilt = virtualView.tilt(), lastZoom = virtualView.zoom();
             {
-                eofContext0 = !inStreamContext0->getFrame(0);
+                std::lock_guard<std::mutex> lock(viewRequest->mutex);
+                if(viewRequest->isPending)
+                {
+                    virtualView.set(viewRequest->pan, viewRequest->tilt, viewRequest->zoom);
+                    viewRequest->isPending = false;
+                }
             }
-            if(inStreamContext1->timeDelay < maxDelay)
+            if(glWindow)
             {
-                eofContext1 = !inStreamContext1->getFrame(0);
+                // Note: arrow keys pan and tilt, page up/down zoom and home resets the view
+                const float moveStep = 0.02f, zoomStep = 1.02f;
+                if(glfwGetKey(glWindow, GLFW_KEY_LEFT) == GLFW_PRESS) virtualView.move(-moveStep, 0.0f);
+                if(glfwGetKey(glWindow, GLFW_KEY_RIGHT) == GLFW_PRESS) virtualView.move(moveStep, 0.0f);
+                if(glfwGetKey(glWindow, GLFW_KEY_UP) == GLFW_PRESS) virtualView.move(0.0f, moveStep);
+                if(glfwGetKey(glWindow, GLFW_KEY_DOWN) == GLFW_PRESS) virtualView.move(0.0f, -moveStep);
+                if(glfwGetKey(glWindow, GLFW_KEY_PAGE_UP) == GLFW_PRESS) virtualView.scale(zoomStep);
+                if(glfwGetKey(glWindow, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS) virtualView.scale(1.0f / zoomStep);
+                if(glfwGetKey(glWindow, GLFW_KEY_HOME) == GLFW_PRESS) virtualView.set(0.0f, 0.0f, 1.0f);
             }
-            if(inStreamContext2->timeDelay < maxDelay)
+            if( (virtualView.pan() != lastPan) || (virtualView.tilt() != lastTilt) || (virtualView.zoom() != lastZoom) )
             {
-                eofContext2 = !inStreamContext2->getFrame(0);
+                updateView();
+            }
+        }
+
+        uint64_t frameAbsTime = 0;
+        {
+            // min of input frame timestamps
+            frameAbsTime = std::numeric_limits<uint64_t>::max();
+            for(auto &inStreamCtx : inStreamContexts)
+            {
+                frameAbsTime = std::min(frameAbsTime, inStreamCtx->absTime);
+            }
+
+            bool isEofAll = true;
+            for(auto &inStreamCtx : inStreamContexts)
+            {
+                inStreamCtx->timeDelay = inStreamCtx->absTime - frameAbsTime;
+                if(inStreamCtx->timeDelay < maxDelay)
+                {
+                    isEofAll = !inStreamCtx->getFrame(0) && isEofAll;
+                }
+                else
+                {
+                    isEofAll = false;
+                }
             }
 
-            if(eofContext0 && eofContext1 && eofContext2)
+            if(isEofAll)
             {
                 // No more frames to process,
                 // break rendering loop
@@ -488,7 +1553,7 @@ int main(int argc, char** argv)
                                    (frameAbsTime >= frameDumpOffsetTime);
         const auto frameDumpIdx = isDumpFrameIdRelativeToOffset ? frameDumpCount: frameCount;
 
-        auto dumpJpegAndPtsAndTxt = [](const decltype(inStreamContext0) &inStreamCtx, const std::string &filename)
+        auto dumpJpegAndPtsAndTxt = [](const GenericInputStreamContext *inStreamCtx, const std::string &filename)
         {
             {
                 auto jpegFile = std::fstream(filename, std::ios::out | std::ios::binary);
@@ -502,111 +1567,145 @@ int main(int argc, char** argv)
             }
         };
 
-        boost::asio::thread_pool threadPoolInDecode(inTpoolSize);
-        boost::asio::post(threadPoolInDecode,
-            [&]()
+        // Note: buffers are mapped by the rendering thread, decoding threads only write to them
+        if(isPboUploadEnabled)
+        {
+            for(uint32_t camIdx=0; camIdx<cameraCount; camIdx++)
             {
-                if( (inStreamContext0->jpegBufferSize > 0) && (inStreamContext0->timeDelay < maxDelay) )
+                if(isCameraInView[camIdx])
                 {
-                    if(isFrameDumped && !frameDumpPath.empty())
-                    {
-                        dumpJpegAndPtsAndTxt(inStreamContext0, frameDumpPath + std::to_string(frameDumpIdx) + "in0.jpg");
-                    }
-                    inStreamContext0->decodeJpeg();
-                } else {
-                    inStreamContext0->decodeWhite();
+                    inStreamContexts[camIdx]->targetFrame = inPixelUnpackRings[camIdx]->map();
                 }
             }
-        );
-        boost::asio::post(threadPoolInDecode,
-            [&]()
-            {
-                if( (inStreamContext1->jpegBufferSize > 0) && (inStreamContext1->timeDelay < maxDelay) )
+        }
+
+        boost::asio::thread_pool threadPoolInDecode(inTpoolSize);
+        for(uint32_t camIdx=0; camIdx<cameraCount; camIdx++)
+        {
+            boost::asio::post(threadPoolInDecode,
+                [&, camIdx]()
                 {
-                    if(isFrameDumped && !frameDumpPath.empty())
+                    auto inStreamCtx = inStreamContexts[camIdx].get();
+                    const bool hasFrame = (inStreamCtx->jpegBufferSize > 0) && (inStreamCtx->timeDelay < maxDelay);
+                    if(hasFrame && isFrameDumped && !frameDumpPath.empty())
                     {
-                        dumpJpegAndPtsAndTxt(inStreamContext1, frameDumpPath + std::to_string(frameDumpIdx) + "in1.jpg");
+                        dumpJpegAndPtsAndTxt(inStreamCtx, frameDumpPath + std::to_string(frameDumpIdx) + "in" + std::to_string(camIdx) + ".jpg");
                     }
-                    inStreamContext1->decodeJpeg();
-                } else {
-                    inStreamContext1->decodeWhite();
-                }
-            }
-        );
-        boost::asio::post(threadPoolInDecode,
-            [&]()
-            {
-                if( (inStreamContext2->jpegBufferSize > 0) && (inStreamContext2->timeDelay < maxDelay) )
-                {
-                    if(isFrameDumped && !frameDumpPath.empty())
+
+                    // Note: an input stream out of view is still parsed and dumped (i.e., kept in sync), but not decoded
+                    if(!isCameraInView[camIdx])
+                    {
+                        return;
+                    }
+
+                    if(hasFrame)
                     {
-                        dumpJpegAndPtsAndTxt(inStreamContext2, frameDumpPath + std::to_string(frameDumpIdx) + "in2.jpg");
+                        inStreamCtx->decodeJpeg();
+                    } else {
+                        inStreamCtx->decodeWhite();
                     }
-                    inStreamContext2->decodeJpeg();
-                } else {
-                    inStreamContext2->decodeWhite();
                 }
-            }
-        );
+            );
+        }
         threadPoolInDecode.join();
 
         const auto frameT3 = std::chrono::high_resolution_clock::now();
         // input frame dump time
 
-        uint8_t *bmpBuffer0 = inStreamContext0->rgbaBuffer;
-        uint8_t *bmpBuffer1 = inStreamContext1->rgbaBuffer;
-        uint8_t *bmpBuffer2 = inStreamContext2->rgbaBuffer;
+        // Note: frames are referenced until rendering is done
+        std::vector<std::shared_ptr<inastitch::jpeg::Frame>> inFrames(cameraCount);
+        for(uint32_t camIdx=0; camIdx<cameraCount; camIdx++)
+        {
+            // Note: a stream out of view keeps its last frame, which is not drawn
+            if(isCameraInView[camIdx])
+            {
+                inFrames[camIdx] = inStreamContexts[camIdx]->frame;
+            }
+        }
 
-        glfwPollEvents();
+        if(glWindow)
+        {
+            glfwPollEvents();
+        }
         GL_CHECK( glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT) );
 
-        GL_CHECK( glUseProgram(glShaderProgram) );
-        // vertex shader
-        GL_CHECK( glShaderModelMatrixUni = glGetUniformLocation(glShaderProgram, "model") );
-        GL_CHECK( glShaderViewMatrixUni = glGetUniformLocation(glShaderProgram, "view") );
-        GL_CHECK( glShaderProjMatrixUni = glGetUniformLocation(glShaderProgram, "proj") );
-        // pixel shader
-        GL_CHECK( glShaderWarpMatrixUni = glGetUniformLocation(glShaderProgram, "warp") );
         const auto frameT4 = std::chrono::high_resolution_clock::now();
         // clear and prepare shader time
 
-        GL_CHECK( glBindTexture(GL_TEXTURE_2D, texture0) );
-        if(bmpBuffer0 != nullptr)
+        // Note: uploads go to other textures than the ones the previous draws sample from
+        inTextureRing->advance();
+        for(uint32_t camIdx=0; camIdx<cameraCount; camIdx++)
+        {
+            if(inFrames[camIdx])
+            {
+                inTextureRing->upload(camIdx, *inFrames[camIdx], inPixelUnpackRings[camIdx].get());
+            }
+        }
+
+        // Note: a stream without frame (or out of view) is drawn with zero positions (i.e., nothing is rasterized)
+        std::vector<CameraUniforms> frameCameraUniforms(cameraCount);
+        for(uint32_t camIdx=0; camIdx<cameraCount; camIdx++)
+        {
+            auto &uniforms = frameCameraUniforms[camIdx];
+            uniforms = cameraUniforms[camIdx];
+            if(!inFrames[camIdx])
+            {
+                uniforms.visible = 0.0f;
+            }
+            const auto &layerScale = inTextureRing->layerScale(camIdx);
+            std::copy(layerScale.begin(), layerScale.end(), uniforms.texScale);
+            if(gainCompensator)
+            {
+                const auto &gain = gainCompensator->gain(camIdx);
+                std::copy(gain.begin(), gain.end(), uniforms.gain);
+            }
+        }
+        const auto cameraUniformsSize = cameraCount * sizeof(CameraUniforms);
+        if(memcmp(frameCameraUniforms.data(), lastCameraUniforms.data(), cameraUniformsSize) != 0)
         {
-            GL_CHECK( glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, textureWidth, textureHeight, GL_RGBA, GL_UNSIGNED_BYTE, bmpBuffer0) );
-            GL_CHECK( glUniformMatrix4fv(glShaderModelMatrixUni, 1, GL_FALSE, glm::value_ptr(modelMat[0])) );
-            GL_CHECK( glUniformMatrix4fv(glShaderViewMatrixUni, 1, GL_FALSE, glm::value_ptr(viewMat[0])) );
-            GL_CHECK( glUniformMatrix4fv(glShaderProjMatrixUni, 1, GL_FALSE, glm::value_ptr(projMat)) );
-            GL_CHECK( glUniformMatrix3fv(glShaderWarpMatrixUni, 1, GL_FALSE, glm::value_ptr(texWarpMat[0])) );
-            GL_CHECK( glDrawArrays(GL_TRIANGLES, 0, 6) );
+            GL_CHECK( glBindBuffer(GL_UNIFORM_BUFFER, glCameraUniformBuffer) );
+            GL_CHECK( glBufferSubData(GL_UNIFORM_BUFFER, 0, cameraUniformsSize, frameCameraUniforms.data()) );
+            GL_CHECK( glBindBuffer(GL_UNIFORM_BUFFER, 0) );
+            lastCameraUniforms = frameCameraUniforms;
         }
 
-        if(bmpBuffer1 != nullptr)
+        // all input streams at once
+        GL_CHECK( glUseProgram(glShaderProgram) );
+        inTextureRing->bind();
+        warpMesh->draw();
+
+        // Note: gains solved from the statistics apply from the next frame
+        if(gainCompensator)
         {
-            GL_CHECK( glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, textureWidth, textureHeight, GL_RGBA, GL_UNSIGNED_BYTE, bmpBuffer1) );
-            GL_CHECK( glUniformMatrix4fv(glShaderModelMatrixUni, 1, GL_FALSE, glm::value_ptr(modelMat[1])) );
-            GL_CHECK( glUniformMatrix4fv(glShaderViewMatrixUni, 1, GL_FALSE, glm::value_ptr(viewMat[1])) );
-            GL_CHECK( glUniformMatrix4fv(glShaderProjMatrixUni, 1, GL_FALSE, glm::value_ptr(projMat)) );
-            GL_CHECK( glUniformMatrix3fv(glShaderWarpMatrixUni, 1, GL_FALSE, glm::value_ptr(texWarpMat[1])) );
-            GL_CHECK( glDrawArrays(GL_TRIANGLES, 0, 6) );
+            gainCompensator->update(*warpMesh);
         }
 
-        if(bmpBuffer2 != nullptr)
+        // other views, from the same textures and camera uniforms
+        if(!outViews.empty())
+        {
+            for(auto &view : outViews)
+            {
+                GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, view->target->framebuffer()) );
+                GL_CHECK( glViewport(0, 0, view->target->width(), view->target->height()) );
+                GL_CHECK( glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT) );
+                GL_CHECK( glUniformMatrix4fv(glVirtualViewUni, 1, GL_FALSE, glm::value_ptr(view->virtualView.matrix())) );
+                view->warpMesh->draw();
+            }
+            GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, glOutFramebuffer) );
+            GL_CHECK( glViewport(0, 0, windowWidth, windowHeight) );
+            GL_CHECK( glUniformMatrix4fv(glVirtualViewUni, 1, GL_FALSE, glm::value_ptr(virtualView.matrix())) );
+        }
+        for(uint32_t planeIdx=inastitch::opengl::TextureRing::maxPlaneCount; planeIdx-- > 0; )
         {
-            GL_CHECK( glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, textureWidth, textureHeight, GL_RGBA, GL_UNSIGNED_BYTE, bmpBuffer2) );
-            GL_CHECK( glUniformMatrix4fv(glShaderModelMatrixUni, 1, GL_FALSE, glm::value_ptr(modelMat[2])) );
-            GL_CHECK( glUniformMatrix4fv(glShaderViewMatrixUni, 1, GL_FALSE, glm::value_ptr(viewMat[2])) );
-            GL_CHECK( glUniformMatrix4fv(glShaderProjMatrixUni, 1, GL_FALSE, glm::value_ptr(projMat)) );
-            GL_CHECK( glUniformMatrix3fv(glShaderWarpMatrixUni, 1, GL_FALSE, glm::value_ptr(texWarpMat[2])) );
-            GL_CHECK( glDrawArrays(GL_TRIANGLES, 0, 6) );
+            GL_CHECK( glActiveTexture(GL_TEXTURE0 + planeIdx) );
+            GL_CHECK( glBindTexture(GL_TEXTURE_2D_ARRAY, 0) ); // unbind
         }
-        GL_CHECK( glBindTexture(GL_TEXTURE_2D, 0) ); // unbind
         const auto frameT5 = std::chrono::high_resolution_clock::now();
         // render video texture time
 
         if(isOverlayEnabled)
         {
-            overlayHelper.clear();
+            textOverlay->clear();
 
             const auto frameTime = std::chrono::duration_cast<std::chrono::milliseconds>(frameT5-frameT4).count();
 
@@ -616,112 +1715,130 @@ int main(int argc, char** argv)
                 const auto stepY = 7;
 
                 static const char header[] = "Inatech stitcher";
-                overlayHelper.putString(baseX, baseY+stepY*0, header, sizeof(header));
-                overlayHelper.putString(baseX, baseY+stepY*1, "FRAME ", 6);
-                overlayHelper.putNumber(baseX+30, baseY+stepY*1, frameCount, 8);
-            }
-
-            overlayHelper.putString(10,    224, "CAM1=", 5);
-            overlayHelper.putNumber(10+25, 224, inStreamContext1->timeDelay, 6);
-            overlayHelper.putString(10+68, 224, "us", 2);
-
-            overlayHelper.putString(330,    224, "CAM0=", 5);
-            overlayHelper.putNumber(330+25, 224, inStreamContext0->timeDelay, 6);
-            overlayHelper.putString(330+68, 224, "us", 2);
-
-            overlayHelper.putString(650,    224, "CAM2=", 5);
-            overlayHelper.putNumber(650+25, 224, inStreamContext2->timeDelay, 6);
-            overlayHelper.putString(650+68, 224, "us", 2);
-
-            auto overlayModelMat = identMat4;
-            overlayModelMat[0][0] = 3.15f;
-            overlayModelMat[1][1] = 4.2f;
-            glBindTexture(GL_TEXTURE_2D, textureOverlay);
-            GL_CHECK( glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, overlayWidth, overlayHeight, GL_RGBA, GL_UNSIGNED_BYTE, overlayHelper.rgbaBuffer()) );
-            GL_CHECK( glUniformMatrix4fv(glShaderModelMatrixUni, 1, GL_FALSE, glm::value_ptr(overlayModelMat)) );
-            GL_CHECK( glUniformMatrix4fv(glShaderViewMatrixUni, 1, GL_FALSE, glm::value_ptr(identMat4)) );
-            GL_CHECK( glUniformMatrix4fv(glShaderProjMatrixUni, 1, GL_FALSE, glm::value_ptr(identMat4)) );
-            GL_CHECK( glUniformMatrix3fv(glShaderWarpMatrixUni, 1, GL_FALSE, glm::value_ptr(identMat3)) );
-            
-            // for the overlay texture to be transparent, one needs to enable "blend function"
-            GL_CHECK( glEnable(GL_BLEND) );
-            GL_CHECK( glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA) );
-            GL_CHECK( glDrawArrays(GL_TRIANGLES, 0, 6) );
-            GL_CHECK( glDisable(GL_BLEND) );
+                textOverlay->putString(baseX, baseY+stepY*0, header, sizeof(header));
+                textOverlay->putString(baseX, baseY+stepY*1, "FRAME ", 6);
+                textOverlay->putNumber(baseX+30, baseY+stepY*1, frameCount, 8);
+            }
+
+            {
+                // Note: camera delays are on the bottom rows, in camera order
+                const uint32_t baseX = 10;
+                const uint32_t baseY = 224;
+                const uint32_t stepY = 7;
+                const uint32_t labelWidth = 90;
+                const uint32_t labelsPerRow = std::max(1u, std::min(cameraCount, (windowWidth/2 - baseX) / labelWidth));
+                const uint32_t stepX = (windowWidth/2 - baseX) / labelsPerRow;
+
+                for(uint32_t camIdx=0; camIdx<cameraCount; camIdx++)
+                {
+                    const uint32_t x = baseX + (camIdx % labelsPerRow) * stepX;
+                    const uint32_t y = baseY - (camIdx / labelsPerRow) * stepY;
+                    const std::string label = "CAM" + std::to_string(camIdx) + "=";
+                    textOverlay->putString(x, y, label.c_str(), label.size());
+                    textOverlay->putNumber(x+5*label.size(), y, inStreamContexts[camIdx]->timeDelay, 6);
+                    textOverlay->putString(x+5*label.size()+43, y, "us", 2);
+                }
+            }
+
+            textOverlay->draw();
         }
         const auto frameT6 = std::chrono::high_resolution_clock::now();
         // render overlay time
 
         std::chrono::high_resolution_clock::time_point frameT7, frameT8;
         {
-            // TODO: such a big buffer on stack is not a good idea
-            uint8_t framebuffer[pboBufferSize];
-            
-#if !USE_OPENGL_PBO
-            // FBO
-            GL_CHECK( glReadPixels(0, 0, windowWidth, windowHeight, GL_RGBA, GL_UNSIGNED_BYTE, framebuffer) );
-            // this is synchronous and very slow because it forces the OpenGL pipeline to finish all rendering
-#else
-            static int r_idx = 0;
-            int p_idx = 0;
-            r_idx = (r_idx + 1) % pboCount;
-            p_idx = (r_idx + 1 ) % pboCount;
-
-            {
-                GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, pboIds[r_idx]) );
-                GL_CHECK( glReadPixels(0, 0, windowWidth, windowHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr) );
-                // this is supposed to be asynchronous
-                GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
-            }
-            
-            frameT7 = std::chrono::high_resolution_clock::now();
-            
-            {
-                GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, pboIds[p_idx]) );
-                unsigned char* ptr = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pboBufferSize, GL_MAP_READ_BIT));
-                memcpy(framebuffer, ptr, pboBufferSize);
-                GL_CHECK( glUnmapBuffer(GL_PIXEL_PACK_BUFFER) );
-                GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
-            }
-#endif
+            const OutFrameInfo outFrameInfo = { isFrameDumped, frameDumpIdx, frameAbsTime, frameRelTime, frameDiffTime };
+            const bool isReadbackNeeded = (isFrameDumped && (isOutEncodeEnabled || outRawWriter)) || outRawShmRing;
+
+            if(outReadback == OutReadback::Sync)
+            {
+                // Note: file input is not real-time, so wait for the encoders rather than dropping frames
+                std::shared_ptr<inastitch::jpeg::Frame> outFrame;
+                if(isFrameDumped && isOutEncodeEnabled)
+                {
+                    outFrame = outEncoderPipeline->acquireFrame(isFileInput);
+                }
+                else if(isFrameDumped && outRawWriter)
+                {
+                    outFrame = outRawWriter->acquireFrame(isFileInput);
+                }
+
+                // Note: pixels are read back straight into shared memory, unless they are also encoded
+                uint8_t* const outShmBuffer = outRawShmRing ? outRawShmRing->beginWrite() : nullptr;
+                uint8_t* const outReadbackBuffer = outFrame ? outFrame->buffer : outShmBuffer;
+                frameT7 = std::chrono::high_resolution_clock::now();
+
+                if(outReadbackBuffer)
+                {
+                    readOutputPixels(outReadbackBuffer);
+                    // this is synchronous and very slow because it forces the OpenGL pipeline to finish all rendering
+                    publishOutFrame(std::move(outFrame), outReadbackBuffer, outShmBuffer, outFrameInfo);
+                }
+            }
+            else if(outReadback == OutReadback::PixelPackRing)
+            {
+                // Note: completed read backs are handed over first,
+                //       waiting for the oldest one only when no buffer is left for this frame
+                publishMappedOutFrames(!outPixelPackRing->hasFreeBuffer());
+                frameT7 = std::chrono::high_resolution_clock::now();
+
+                // Note: file input is not real-time, so wait for the outputs rather than dropping frames
+                if(isReadbackNeeded && outPixelPackRing->bind(isFileInput))
+                {
+                    readOutputPixels(nullptr);
+                    // this is asynchronous, pixels are mapped once the fence is signaled
+                    outPixelPackRing->unbind();
+                    outPendingFrameInfos.push_back(outFrameInfo);
+                }
+            }
+            else
+            {
+                frameT7 = std::chrono::high_resolution_clock::now();
+            }
             frameT8 = std::chrono::high_resolution_clock::now();
             // read back pixel time
 
-#if 0
-            if(isFrameDumped )
-            {
-                boost::asio::post(threadPoolOutStream,
-                   [&]
-                   {
-                        auto [ jpegData, jpegSize ] = rtpJpegEncoder.encode(framebuffer, windowWidth, windowHeight);
-
-                        const std::string ptsStr = std::to_string(frameAbsTime) + " "
-                                                   + std::to_string(frameRelTime) + " "
-                                                   + std::to_string(frameDiffTime);
-
-                        if(!outFilename.empty())
-                        {
-                            // append to output MJPEG
-                            outJpegFile.write((char*)&jpegData[0], jpegSize);
-
-                            // append to output PTS
-                            outPtsFile << ptsStr << std::endl;
-                        }
-
-                        if(!frameDumpPath.empty())
-                        {
-                            auto jpegFile = std::fstream(frameDumpPath + std::to_string(frameDumpIdx) + "out.jpg", std::ios::out | std::ios::binary);
-                            jpegFile.write((char*)&jpegData[0], jpegSize);
-                            jpegFile.close();
-
-                            auto ptsFile = std::fstream(frameDumpPath + std::to_string(frameDumpIdx) + "out.jpg" + ".pts", std::ios::out);
-                            ptsFile << ptsStr;
-                            ptsFile.close();
-                        }
-                    }
-                );
+            // Note: renditions and other views are read back one frame late, each one to its own encoder,
+            //       i.e., a readback is copied once the next one is started (or right away when none is)
+            auto encodeTarget = [&](inastitch::opengl::RenditionTarget &target, inastitch::jpeg::EncoderPipeline &encoderPipeline,
+                                    std::deque<inastitch::jpeg::EncoderPipeline::FrameInfo> &pendingFrameInfos)
+            {
+                if(isFrameDumped)
+                {
+                    target.readPixels();
+
+                    inastitch::jpeg::EncoderPipeline::FrameInfo targetFrameInfo;
+                    targetFrameInfo.frameIdx = frameDumpIdx;
+                    targetFrameInfo.absTime = frameAbsTime;
+                    targetFrameInfo.relTime = frameRelTime;
+                    targetFrameInfo.offTime = frameDiffTime;
+                    pendingFrameInfos.push_back(targetFrameInfo);
+                }
+
+                while(target.pendingCount() > (isFrameDumped ? 1u : 0u))
+                {
+                    publishTargetFrame(target, encoderPipeline, pendingFrameInfos);
+                }
+            };
+
+            // Note: output is rendered once, renditions are scaled from it
+            GLuint renditionSrcFramebuffer = glOutFramebuffer;
+            uint32_t renditionSrcWidth = windowWidth, renditionSrcHeight = windowHeight;
+            for(auto &rendition : outRenditions)
+            {
+                auto &target = *rendition->target;
+                target.blitFrom(renditionSrcFramebuffer, renditionSrcWidth, renditionSrcHeight);
+                renditionSrcFramebuffer = target.framebuffer();
+                renditionSrcWidth = target.width();
+                renditionSrcHeight = target.height();
+
+                encodeTarget(target, *rendition->encoderPipeline, rendition->pendingFrameInfos);
+            }
+
+            for(auto &view : outViews)
+            {
+                encodeTarget(*view->target, *view->encoderPipeline, view->pendingFrameInfos);
             }
-#endif
 
             frameCount++;
             if(isFrameDumped) frameDumpCount++;
@@ -731,13 +1848,18 @@ int main(int argc, char** argv)
         const auto frameT9 = std::chrono::high_resolution_clock::now();
         // dump output frame
 
-        glfwSwapBuffers(glWindow);
+        if(glWindow)
+        {
+            glfwSwapBuffers(glWindow);
+        }
         
         const auto frameT10 = std::chrono::high_resolution_clock::now();
-        std::cout << "[" << frameCount << "," << frameDumpCount
-                  << "] t0:" << inStreamContext0->timeDelay
-                  << ", t1:" << inStreamContext1->timeDelay
-                  << ", t2:" << inStreamContext2->timeDelay << std::endl;
+        std::cout << "[" << frameCount << "," << frameDumpCount << "]";
+        for(uint32_t camIdx=0; camIdx<cameraCount; camIdx++)
+        {
+            std::cout << ((camIdx == 0) ? " t" : ", t") << camIdx << ":" << inStreamContexts[camIdx]->timeDelay;
+        }
+        std::cout << std::endl;
 
         if(isStatsEnabled)
         std::cout << "inParse:" << std::chrono::duration_cast<std::chrono::microseconds>(frameT2-frameT1).count() << "us"
@@ -750,6 +1872,34 @@ int main(int argc, char** argv)
                   << ", outDump:" << std::chrono::duration_cast<std::chrono::microseconds>(frameT9-frameT8).count() << "us"
                   << ", total:" << std::chrono::duration_cast<std::chrono::microseconds>(frameT10-frameT1).count() << "us"
                   << std::endl;
+
+        if(isStatsEnabled && outHttpServer)
+        {
+            std::cout << "outHttpClients:" << outHttpServer->clientCount()
+                      << ", outHttpDrop:" << outHttpServer->droppedCount() << std::endl;
+        }
+
+        if(isStatsEnabled && outPixelPackRing)
+        {
+            std::cout << "outReadbackPending:" << outPendingFrameInfos.size()
+                      << ", outReadbackDrop:" << outPixelPackRing->droppedCount() << std::endl;
+        }
+
+        if(isStatsEnabled && outRawWriter)
+        {
+            std::cout << "outRawDrop:" << outRawWriter->droppedCount() << std::endl;
+        }
+
+        if(isStatsEnabled && isOutEncodeEnabled)
+        {
+            const auto outStats = outEncoderPipeline->stats();
+            std::cout << "outQueue:" << outStats.queueSize
+                      << ", outDrop:" << outStats.droppedCount
+                      << ", outEnc:" << outStats.lastLatency << "us"
+                      << " (avg:" << outStats.avgLatency << "us"
+                      << ", max:" << outStats.maxLatency << "us)"
+                      << std::endl;
+        }
     }
 
     const auto renderTimeEnd = std::chrono::high_resolution_clock::now();
@@ -763,17 +1913,71 @@ int main(int argc, char** argv)
     {
         std::cout << frameCount << " frames rendered in "
                   << renderTimeMs << "ms"
-                  << " (" << frameCount/(renderTimeMs/1000) << " fps)"
+                  << " (" << frameCount * 1000.0 / std::max<int64_t>(renderTimeMs, 1) << " fps)"
+                  << std::endl;
+    }
+
+    // Note: remaining output frames are written before closing files
+    if(outPixelPackRing)
+    {
+        publishMappedOutFrames(true);
+    }
+    if(outEncoderPipeline)
+    {
+        outEncoderPipeline->flush();
+    }
+    if(outRawWriter)
+    {
+        outRawWriter->flush();
+    }
+    if(isOutEncodeEnabled)
+    {
+        const auto outStats = outEncoderPipeline->stats();
+        std::cout << outStats.encodedCount << " output frames encoded, "
+                  << outStats.droppedCount << " dropped"
+                  << " (avg latency: " << outStats.avgLatency << "us)"
                   << std::endl;
     }
 
     outJpegFile.close();
     outPtsFile.close();
 
-    threadPoolOutStream.join();
-
-    GL_CHECK( glDeleteBuffers(1, &glVextexBufferObject) );
-    glfwTerminate();
+    for(auto &rendition : outRenditions)
+    {
+        while(rendition->target->pendingCount() > 0)
+        {
+            publishTargetFrame(*rendition->target, *rendition->encoderPipeline, rendition->pendingFrameInfos);
+        }
+        rendition->encoderPipeline->flush();
+        rendition->jpegFile.close();
+        rendition->ptsFile.close();
+    }
+    for(auto &view : outViews)
+    {
+        while(view->target->pendingCount() > 0)
+        {
+            publishTargetFrame(*view->target, *view->encoderPipeline, view->pendingFrameInfos);
+        }
+        view->encoderPipeline->flush();
+        view->jpegFile.close();
+        view->ptsFile.close();
+    }
+    // Note: OpenGL objects are released before the context (i.e., before glfwTerminate), in reverse order of creation
+    outRenditions.clear();
+    inPixelUnpackRings.clear();
+    gainCompensator.reset();
+    outViews.clear();
+    warpMesh.reset();
+    outPixelPackRing.reset();
+    outYuvPacker.reset();
+    textOverlay.reset();
+    inTextureRing.reset();
+
+    GL_CHECK( glDeleteBuffers(1, &glCameraUniformBuffer) );
+    if(glWindow)
+    {
+        glfwTerminate();
+    }
 
     return 0;
 }
@@ -3,9 +3,15 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#pragma once
+
+// Local includes:
+#include "inastitch/jpeg/include/FramePool.hpp"
+
 // Std includes:
 #include <cstdint>
 #include <string>
+#include <tuple>
 
 namespace inastitch {
 namespace jpeg {
@@ -19,9 +25,60 @@ public:
 
 public:
     uint8_t* decode(uint8_t* jpegBuffer, uint32_t jpegBufferSize);
+    uint8_t* decodeYuv(uint8_t* jpegBuffer, uint32_t jpegBufferSize);
     void writePpm(const std::string &filename);
 
 public:
+    // Decode into a caller-owned frame, rather than into the decoder buffer
+    void decode(uint8_t* jpegBuffer, uint32_t jpegBufferSize, Frame &frame);
+    void decodeYuv(uint8_t* jpegBuffer, uint32_t jpegBufferSize, Frame &frame);
+
+    // Decode a JPEG slice into the rows of a caller-owned frame, starting at 'firstRow'
+    // Note: frame size must already be set, see RestartSlicer
+    void decodeRows(uint8_t* jpegBuffer, uint32_t jpegBufferSize, Frame &frame, uint32_t firstRow);
+
+public:
+    // Note: decoded frame is scaled by 'num/denom' during decompression (DCT scaling)
+    void setScalingFactor(uint32_t num, uint32_t denom);
+    static std::tuple<uint32_t, uint32_t> getBestScalingFactor(float minScale);
+
+    // Note: region is relative to the frame size (i.e., from 0.0 to 1.0),
+    //       and gets extended to MCU boundaries. Only RGBA decoding is cropped.
+    void setCropRegion(float left, float top, float right, float bottom);
+
+public:
+    uint32_t width() const
+    {
+        return m_frame.width;
+    }
+
+    uint32_t height() const
+    {
+        return m_frame.height;
+    }
+
+    // position of the decoded region in the (uncropped) frame
+    uint32_t cropX() const
+    {
+        return m_frame.cropX;
+    }
+
+    uint32_t cropY() const
+    {
+        return m_frame.cropY;
+    }
+
+    // size of the (uncropped) frame
+    uint32_t fullWidth() const
+    {
+        return m_frame.fullWidth;
+    }
+
+    uint32_t fullHeight() const
+    {
+        return m_frame.fullHeight;
+    }
+
     uint8_t* rgbaBuffer() const
     {
         return m_rgbaBuffer;
@@ -32,20 +89,49 @@ public:
         return m_rgbaBufferSize;
     }
 
+public:
+    static const auto yuvPlaneCount = Frame::yuvPlaneCount;
+
+    uint8_t* yuvPlane(uint32_t planeIdx) const
+    {
+        return m_frame.yuvPlanes[planeIdx];
+    }
+
+    uint32_t yuvPlaneWidth(uint32_t planeIdx) const
+    {
+        return m_frame.yuvPlaneWidths[planeIdx];
+    }
+
+    uint32_t yuvPlaneHeight(uint32_t planeIdx) const
+    {
+        return m_frame.yuvPlaneHeights[planeIdx];
+    }
+
 private:
-    unsigned int m_width = 0;
-    unsigned int m_height = 0;
     unsigned int m_pixelSize = 4; // because TJPF_RGBA
+    uint32_t m_scalingNum = 1;
+    uint32_t m_scalingDenom = 1;
+
+private:
+    bool m_isCropped = false;
+    float m_cropLeft = 0.0f, m_cropTop = 0.0f, m_cropRight = 1.0f, m_cropBottom = 1.0f;
 
 private:
     const uint32_t m_rgbaBufferSize;
 
 private:
     uint8_t* const m_rgbaBuffer;
+    // last frame decoded into 'm_rgbaBuffer'
+    Frame m_frame;
     
+private:
+    void decodeCropped(uint8_t* jpegBuffer, uint32_t jpegBufferSize, Frame &frame);
+
 private:
     // tjhandler
     void* m_jpegDecompressor;
+    // libjpeg decompressor for cropped decoding (created on demand)
+    void* m_jpegCropDecompressor = nullptr;
 };
 
 
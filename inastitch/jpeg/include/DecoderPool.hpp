@@ -0,0 +1,73 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Local includes:
+#include "inastitch/jpeg/include/Decoder.hpp"
+#include "inastitch/jpeg/include/FramePool.hpp"
+
+// Boost includes:
+#include <boost/asio/thread_pool.hpp>
+
+// Std includes:
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+namespace inastitch {
+namespace jpeg {
+
+
+// Decoders shared by decoding threads, each decoder (i.e., turbojpeg handle)
+// being used by a single thread at a time.
+class DecoderPool
+{
+public:
+    // per-stream decoding settings
+    struct Settings
+    {
+        bool isYuv = false;
+        uint32_t scalingNum = 1;
+        uint32_t scalingDenom = 1;
+        float cropLeft = 0.0f, cropTop = 0.0f, cropRight = 1.0f, cropBottom = 1.0f;
+        // Note: frames with restart markers are split into slices decoded in parallel
+        uint32_t maxSliceCount = 1;
+    };
+
+public:
+    // Note: slices are decoded by 'sliceThreadCount' threads, in addition to the calling thread
+    DecoderPool(uint32_t decoderCount, uint32_t sliceThreadCount = 0);
+    ~DecoderPool();
+
+public:
+    // Note: blocks until both a decoder and a frame are available
+    std::shared_ptr<Frame> decode(FramePool &framePool, const Settings &settings,
+                                  uint8_t* jpegBuffer, uint32_t jpegBufferSize);
+
+    // Note: decodes into a frame that is not from a pool (e.g., mapped GPU memory)
+    void decode(Frame &frame, const Settings &settings,
+                uint8_t* jpegBuffer, uint32_t jpegBufferSize);
+
+private:
+    Decoder* acquireDecoder();
+    void releaseDecoder(Decoder *decoder);
+    bool decodeSlices(Frame &frame, const Settings &settings, uint8_t* jpegBuffer, uint32_t jpegBufferSize);
+
+private:
+    std::vector<Decoder*> m_decoders;
+    std::unique_ptr<boost::asio::thread_pool> m_sliceThreadPool;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::vector<Decoder*> m_freeDecoders;
+};
+
+
+} // namespace jpeg
+} // namespace inastitch
@@ -3,6 +3,8 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#pragma once
+
 // Std includes:
 #include <cstdint>
 #include <tuple>
@@ -18,7 +20,9 @@ public:
     ~Encoder();
 
 public:
-    std::tuple<uint8_t* const, long unsigned int> encode(const uint8_t *rgbaData, uint32_t width, uint32_t height);
+    std::tuple<uint8_t* const, long unsigned int> encode(const uint8_t *rgbaData, uint32_t width, uint32_t height, int jpegQuality = 75);
+    // Note: planes are JFIF YCbCr 4:2:0, top-down and without padding
+    std::tuple<uint8_t* const, long unsigned int> encodeYuv(const uint8_t * const yuvPlanes[3], uint32_t width, uint32_t height, int jpegQuality = 75);
 
 private:
     const uint32_t m_jpegBufferSize;
@@ -0,0 +1,127 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Local includes:
+#include "inastitch/jpeg/include/StripEncoder.hpp"
+#include "inastitch/jpeg/include/FramePool.hpp"
+#include "inastitch/jpeg/include/RateController.hpp"
+
+// Std includes:
+#include <cstdint>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+namespace inastitch {
+namespace jpeg {
+
+
+// Bounded queue of RGBA frames encoded by several workers (i.e., one encoder each),
+// encoded frames being written in submission order by a single writer thread.
+// Note: each worker can also split its frame into strips encoded in parallel
+class EncoderPipeline
+{
+public:
+    // timestamps of an output frame
+    struct FrameInfo
+    {
+        uint64_t frameIdx = 0;
+        // absolute time since epoch (in us)
+        uint64_t absTime = 0;
+        uint64_t relTime = 0;
+        uint64_t offTime = 0;
+    };
+
+    struct EncodedFrame
+    {
+        FrameInfo info;
+        // Note: shared, so that outputs can hold on to it without copy
+        std::shared_ptr<const std::vector<uint8_t>> jpegData;
+        int quality = 0;
+        // Note: more than 1 when re-encoded by the rate controller
+        uint32_t encodeCount = 0;
+    };
+
+    using Writer = std::function<void(const EncodedFrame&)>;
+
+    struct Stats
+    {
+        uint32_t queueSize = 0;
+        uint64_t encodedCount = 0;
+        uint64_t droppedCount = 0;
+        // from submission to end of encoding (in us)
+        uint64_t lastLatency = 0;
+        uint64_t maxLatency = 0;
+        uint64_t avgLatency = 0;
+    };
+
+public:
+    // Note: without rate controller, frames are encoded with the default quality
+    EncoderPipeline(uint32_t workerCount, uint32_t stripCount, uint32_t maxQueueSize,
+                    uint32_t maxRgbaBufferSize, uint32_t maxJpegBufferSize,
+                    Writer writer, RateController *rateController = nullptr);
+    ~EncoderPipeline();
+
+public:
+    // Returns a frame to read pixels into, or nullptr when the queue is full (i.e., frame is dropped).
+    // Note: when blocking, waits for a frame instead of dropping
+    std::shared_ptr<Frame> acquireFrame(bool isBlocking);
+
+    void push(std::shared_ptr<Frame> frame, const FrameInfo &info);
+
+    // Note: waits for all submitted frames to be written, then stops all threads
+    void flush();
+
+    Stats stats();
+
+private:
+    void encodeLoop();
+    void writeLoop();
+
+private:
+    struct Job
+    {
+        uint64_t seqIdx;
+        std::shared_ptr<Frame> frame;
+        FrameInfo info;
+        std::chrono::steady_clock::time_point pushTime;
+    };
+
+private:
+    const uint32_t m_stripCount;
+    const uint32_t m_maxJpegBufferSize;
+    // Note: frames in queue or being encoded are not available
+    FramePool m_framePool;
+    const Writer m_writer;
+    RateController* const m_rateController;
+
+    std::vector<std::thread> m_encodeThreads;
+    std::thread m_writeThread;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_jobCondition;
+    std::condition_variable m_encodedCondition;
+    std::deque<Job> m_jobs;
+    // encoded frames waiting for previous frames to be written
+    std::map<uint64_t, EncodedFrame> m_encodedFrames;
+    uint64_t m_nextSeqIdx = 0;
+    uint64_t m_nextWriteSeqIdx = 0;
+    bool m_isStopping = false;
+    Stats m_stats;
+    uint64_t m_totalLatency = 0;
+};
+
+
+} // namespace jpeg
+} // namespace inastitch
@@ -0,0 +1,85 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Std includes:
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+namespace inastitch {
+namespace jpeg {
+
+
+struct Frame
+{
+    static const auto yuvPlaneCount = 3;
+
+    Frame(uint8_t* frameBuffer, uint32_t frameBufferSize)
+        : buffer(frameBuffer)
+        , bufferSize(frameBufferSize)
+    { }
+
+    uint8_t* const buffer;
+    const uint32_t bufferSize;
+
+    // size of the decoded region
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // position of the decoded region in the (uncropped) frame
+    uint32_t cropX = 0;
+    uint32_t cropY = 0;
+    // size of the (uncropped) frame
+    uint32_t fullWidth = 0;
+    uint32_t fullHeight = 0;
+
+    // Note: YUV planes are stored one after the other in the buffer
+    bool isYuv = false;
+    uint8_t* yuvPlanes[yuvPlaneCount] = { nullptr, nullptr, nullptr };
+    uint32_t yuvPlaneWidths[yuvPlaneCount] = { 0, 0, 0 };
+    uint32_t yuvPlaneHeights[yuvPlaneCount] = { 0, 0, 0 };
+
+    // absolute time since epoch (in us)
+    uint64_t absTime = 0;
+};
+
+// Pre-allocated frames, recycled when the last reference is released.
+// Note: the pool must outlive all the frames it gave away.
+class FramePool
+{
+public:
+    FramePool(uint32_t frameCount, uint32_t frameBufferSize);
+    ~FramePool();
+
+public:
+    // Note: blocks until a frame is available
+    std::shared_ptr<Frame> acquire();
+    // Note: returns nullptr when no frame is available
+    std::shared_ptr<Frame> tryAcquire();
+
+    uint32_t frameBufferSize() const
+    {
+        return m_frameBufferSize;
+    }
+
+private:
+    void release(Frame *frame);
+
+private:
+    const uint32_t m_frameBufferSize;
+    std::vector<Frame*> m_frames;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::vector<Frame*> m_freeFrames;
+};
+
+
+} // namespace jpeg
+} // namespace inastitch
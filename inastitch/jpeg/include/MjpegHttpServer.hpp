@@ -0,0 +1,84 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Std includes:
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace inastitch {
+namespace jpeg {
+
+
+// HTTP server streaming encoded frames as "multipart/x-mixed-replace" (i.e., MJPEG in a browser).
+// Note: all clients are served by one thread with non-blocking sockets, and share the same JPEG buffer.
+//       A client that is still sending a frame skips to the latest one (i.e., slow clients drop frames).
+class MjpegHttpServer
+{
+public:
+    using JpegBuffer = std::shared_ptr<const std::vector<uint8_t>>;
+
+public:
+    // Note: 'bindStr' is "[address:]port", the server only listens on loopback (127.0.0.1) when no address is given
+    MjpegHttpServer(const std::string &bindStr, uint32_t maxClientCount);
+    ~MjpegHttpServer();
+
+public:
+    // Note: never blocks
+    void publishFrame(JpegBuffer jpegBuffer, uint64_t absTime);
+
+    uint32_t clientCount();
+    uint64_t droppedCount();
+
+private:
+    struct Client
+    {
+        int socketFd;
+        std::string request;
+        bool isStreaming = false;
+
+        // bytes to send: 'prefix' (response and part headers), then JPEG data and CRLF
+        std::string prefix;
+        JpegBuffer frame;
+        size_t sentSize = 0;
+        uint64_t lastFrameSeqIdx = 0;
+    };
+
+private:
+    // Wakes the serve loop up (e.g., new frame or stopping).
+    void notifyServeLoop();
+    void serveLoop();
+    void acceptClients();
+    // Note: return false when the client must be closed
+    bool readRequest(Client &client);
+    bool writeFrame(Client &client);
+    void startFrame(Client &client);
+
+private:
+    const uint32_t m_maxClientCount;
+    int m_listenFd;
+    // Note: wakes up the serving thread on new frame or stop
+    int m_eventFd;
+    std::vector<Client> m_clients;
+    std::thread m_serveThread;
+
+private:
+    std::mutex m_mutex;
+    JpegBuffer m_latestFrame;
+    uint64_t m_latestAbsTime = 0;
+    uint64_t m_latestSeqIdx = 0;
+    bool m_isStopping = false;
+    uint32_t m_clientCount = 0;
+    uint64_t m_droppedCount = 0;
+};
+
+
+} // namespace jpeg
+} // namespace inastitch
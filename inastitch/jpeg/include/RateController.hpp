@@ -0,0 +1,74 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Std includes:
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+namespace inastitch {
+namespace jpeg {
+
+
+// Chooses the JPEG quality of each frame to reach a target frame size (or bitrate).
+// Note: the model is log(size) = a + b * quality, fitted on recent frames, so that it follows scene changes.
+// Note: thread-safe, shared by all encoding workers
+class RateController
+{
+public:
+    // Note: either 'targetFrameSize' (in bytes) or 'targetBitrate' (in bit/s) is used, the other one being 0
+    RateController(uint32_t targetFrameSize, uint64_t targetBitrate, bool isReencodeEnabled);
+
+public:
+    // Note: 'frameTime' is the time since the previous frame (in us), 0 if unknown
+    uint32_t getTargetSize(uint64_t frameTime);
+
+    int getQuality(uint32_t targetSize);
+
+    // Note: a frame overshooting its target is worth re-encoding when a lower quality is predicted
+    bool isReencodeNeeded(uint32_t targetSize, int quality, uint32_t jpegSize);
+
+    void update(int quality, uint32_t jpegSize);
+
+    // achieved bitrate (in bit/s) over recent frames
+    uint64_t getBitrate();
+
+public:
+    static const int minQuality = 10;
+    static const int maxQuality = 95;
+    static const int defaultQuality = 75;
+
+private:
+    void fitModel();
+
+private:
+    const uint32_t m_targetFrameSize;
+    const uint64_t m_targetBitrate;
+    const bool m_isReencodeEnabled;
+
+private:
+    struct Sample
+    {
+        int quality;
+        double logSize;
+    };
+
+    static const auto maxSampleCount = 16;
+
+    std::mutex m_mutex;
+    std::deque<Sample> m_samples;
+    // model: log(size) = a + b * quality
+    double m_modelA;
+    double m_modelB;
+    // smoothed frame size (in bytes) and frame time (in us)
+    double m_avgFrameSize = 0.0;
+    double m_avgFrameTime = 0.0;
+};
+
+
+} // namespace jpeg
+} // namespace inastitch
@@ -0,0 +1,84 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Std includes:
+#include <cstdint>
+#include <vector>
+
+namespace inastitch {
+namespace jpeg {
+
+
+// Split a baseline JPEG with restart markers (DRI/RSTn) into independent JPEG slices,
+// each slice holding a range of MCU rows.
+class RestartSlicer
+{
+public:
+    // Note: returns false when the JPEG cannot be split
+    //       (e.g., no restart marker, progressive, multi-scan)
+    bool parse(const uint8_t* jpegBuffer, uint32_t jpegBufferSize);
+
+    // Note: returns MCU row boundaries, from 0 to 'mcuRowCount()',
+    //       only at rows starting with a restart marker.
+    std::vector<uint32_t> getSliceRows(uint32_t maxSliceCount) const;
+
+    // Note: returns the JPEG slice size, or 0 when 'sliceBufferSize' is too small
+    uint32_t buildSlice(uint32_t firstRow, uint32_t endRow, uint8_t* sliceBuffer, uint32_t sliceBufferSize) const;
+
+public:
+    uint32_t width() const
+    {
+        return m_width;
+    }
+
+    uint32_t height() const
+    {
+        return m_height;
+    }
+
+    uint32_t mcuHeight() const
+    {
+        return m_mcuHeight;
+    }
+
+    uint32_t mcuRowCount() const
+    {
+        return m_mcuRowCount;
+    }
+
+    // upper bound of any slice size
+    uint32_t maxSliceSize() const
+    {
+        return m_jpegBufferSize + 2;
+    }
+
+private:
+    const uint8_t* m_jpegBuffer = nullptr;
+    uint32_t m_jpegBufferSize = 0;
+
+private:
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_mcuHeight = 0;
+    uint32_t m_mcuPerRow = 0;
+    uint32_t m_mcuRowCount = 0;
+    uint32_t m_restartInterval = 0;
+
+private:
+    // offset of the SOF frame height field
+    uint32_t m_sofHeightOffset = 0;
+    // offset of the first byte after the SOS header (i.e., entropy-coded data)
+    uint32_t m_scanOffset = 0;
+    // offset of the EOI marker
+    uint32_t m_eoiOffset = 0;
+    // offset of all RSTn markers
+    std::vector<uint32_t> m_restartOffsets;
+};
+
+
+} // namespace jpeg
+} // namespace inastitch
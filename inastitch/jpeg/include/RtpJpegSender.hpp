@@ -0,0 +1,84 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// C includes:
+#include <netinet/in.h>
+
+// Std includes:
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace inastitch {
+namespace jpeg {
+
+
+// RTP/JPEG (RFC2435) packetizer, sending encoded frames to unicast or multicast destinations.
+// Note: packets are paced by a token bucket so as not to overrun receiver socket buffers
+class RtpJpegSender
+{
+public:
+    // Note: destinations are "address:port", 'maxBitrate' is in bit/s (0 for no pacing)
+    RtpJpegSender(const std::vector<std::string> &destinationStrs, uint64_t maxBitrate);
+    ~RtpJpegSender();
+
+public:
+    // Note: returns false when the JPEG cannot be sent as RTP/JPEG (e.g., not baseline, too large)
+    bool sendFrame(const uint8_t* jpegBuffer, uint32_t jpegBufferSize, uint64_t absTime);
+
+    uint64_t sentPacketCount() const
+    {
+        return m_sentPacketCount;
+    }
+
+private:
+    void sendPackets();
+    void waitForTokens(uint32_t byteCount);
+
+private:
+    // Note: fits in an Ethernet MTU with IPv4 and UDP headers
+    static const auto maxPacketSize = 1472;
+    static const auto rtpHeaderSize = 12;
+    static const auto jpegHeaderSize = 8;
+    static const auto restartHeaderSize = 4;
+    static const auto quantHeaderSize = 4;
+    static const auto maxQuantTableCount = 2;
+    static const auto maxHeaderSize = rtpHeaderSize + jpegHeaderSize + restartHeaderSize + quantHeaderSize + 64 * maxQuantTableCount;
+    // Note: sendmmsg batch size
+    static const auto maxBatchSize = 64;
+
+private:
+    int m_socketFd;
+    std::vector<struct sockaddr_in> m_destinations;
+
+    uint16_t m_sequenceNumber;
+    const uint32_t m_syncSourceId;
+
+private:
+    // token bucket (in bytes)
+    const uint64_t m_byteRate;
+    const double m_maxTokens;
+    double m_tokens;
+    std::chrono::steady_clock::time_point m_lastRefillTime;
+
+private:
+    // packets of the current frame: header is copied, payload points into the JPEG data
+    struct Packet
+    {
+        uint8_t header[maxHeaderSize];
+        uint32_t headerSize;
+        const uint8_t* payload;
+        uint32_t payloadSize;
+    };
+    std::vector<Packet> m_packets;
+    uint64_t m_sentPacketCount = 0;
+};
+
+
+} // namespace jpeg
+} // namespace inastitch
@@ -0,0 +1,65 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Local includes:
+#include "inastitch/jpeg/include/Encoder.hpp"
+
+// Boost includes:
+#include <boost/asio/thread_pool.hpp>
+
+// Std includes:
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace inastitch {
+namespace jpeg {
+
+
+// Encodes horizontal strips of a frame in parallel (one encoder each),
+// strips being joined into a single JPEG with restart markers (DRI/RSTn).
+// Note: strips share the same tables, since they are encoded with the same quality and subsampling
+class StripEncoder
+{
+public:
+    // Note: with a single strip, this is the same as 'Encoder'
+    StripEncoder(uint32_t stripCount, uint32_t maxJpegBufferSize);
+    ~StripEncoder();
+
+public:
+    std::tuple<uint8_t* const, long unsigned int> encode(const uint8_t *rgbaData, uint32_t width, uint32_t height, int jpegQuality = 75);
+    std::tuple<uint8_t* const, long unsigned int> encodeYuv(const uint8_t * const yuvPlanes[3], uint32_t width, uint32_t height, int jpegQuality = 75);
+
+private:
+    // Note: 'encodeStrip' encodes image rows from 'firstRow' to 'endRow' with the given encoder
+    using StripFunc = std::function<std::tuple<uint8_t* const, long unsigned int>(Encoder&, uint32_t, uint32_t)>;
+    std::tuple<uint8_t* const, long unsigned int> encodeStrips(uint32_t width, uint32_t height, uint32_t mcuWidth, uint32_t mcuHeight, const StripFunc &encodeStrip);
+
+    // Note: returns the joined JPEG size, 0 if strips cannot be joined
+    uint32_t joinStrips(uint32_t stripCount, uint32_t height, uint32_t restartInterval);
+
+private:
+    const uint32_t m_jpegBufferSize;
+    uint8_t* const m_jpegBuffer;
+    std::vector<std::unique_ptr<Encoder>> m_encoders;
+    std::unique_ptr<boost::asio::thread_pool> m_stripThreadPool;
+
+private:
+    // encoded strips (i.e., in encoder buffers)
+    struct Strip
+    {
+        const uint8_t* jpegData;
+        uint32_t jpegSize;
+    };
+    std::vector<Strip> m_strips;
+};
+
+
+} // namespace jpeg
+} // namespace inastitch
@@ -11,24 +11,82 @@
 // Note: libjpeg-turbo != libturbojpeg
 // => apt install libturbojpeg0-dev
 
+// Libjpeg includes:
+#include <cstdio>
+#include <csetjmp>
+#include <jpeglib.h>
+// Note: partial decoding (jpeg_crop_scanline, jpeg_skip_scanlines) is only available
+//       from the libjpeg API of libjpeg-turbo, not from the TurboJPEG API.
+// => apt install libjpeg62-turbo-dev
+
 // Std includes:
 #include <iostream>
 #include <fstream>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+struct CropDecompressor
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    std::jmp_buf jumpBuffer;
+};
+
+void cropDecompressorErrorExit(j_common_ptr cinfo)
+{
+    // Note: default libjpeg behavior is to exit the process
+    auto cropDecompressor = reinterpret_cast<CropDecompressor*>(cinfo->client_data);
+    std::longjmp(cropDecompressor->jumpBuffer, 1);
+}
+
+void cropDecompressorEmitMessage(j_common_ptr, int)
+{
+    // Avoid endless warning about "Warning: unknown JFIF revision number 2.01"
+}
+
+} // namespace
 
 inastitch::jpeg::Decoder::Decoder(uint32_t maxRgbBufferSize)
         : m_rgbaBufferSize(maxRgbBufferSize)
         , m_rgbaBuffer( new uint8_t[m_rgbaBufferSize] )
+        , m_frame( m_rgbaBuffer, m_rgbaBufferSize )
         , m_jpegDecompressor( tjInitDecompress() )
 { }
 
 inastitch::jpeg::Decoder::~Decoder()
 {
     tjDestroy(m_jpegDecompressor);
+    if(m_jpegCropDecompressor != nullptr)
+    {
+        auto cropDecompressor = static_cast<CropDecompressor*>(m_jpegCropDecompressor);
+        jpeg_destroy_decompress(&cropDecompressor->cinfo);
+        delete cropDecompressor;
+    }
     delete[] m_rgbaBuffer;
 }
 
 uint8_t* inastitch::jpeg::Decoder::decode(uint8_t *jpegBuffer, uint32_t jpegBufferSize)
 {
+    decode(jpegBuffer, jpegBufferSize, m_frame);
+    return m_rgbaBuffer;
+}
+
+uint8_t* inastitch::jpeg::Decoder::decodeYuv(uint8_t *jpegBuffer, uint32_t jpegBufferSize)
+{
+    decodeYuv(jpegBuffer, jpegBufferSize, m_frame);
+    return m_rgbaBuffer;
+}
+
+void inastitch::jpeg::Decoder::decode(uint8_t *jpegBuffer, uint32_t jpegBufferSize, Frame &frame)
+{
+    if(m_isCropped)
+    {
+        decodeCropped(jpegBuffer, jpegBufferSize, frame);
+        return;
+    }
+
     int32_t jpegWidth = 0, jpegHeight = 0, jpegSubsamp = 0;
     int tjError = 0;
 
@@ -39,35 +97,255 @@ uint8_t* inastitch::jpeg::Decoder::decode(uint8_t *jpegBuffer, uint32_t jpegBuff
         //std::cerr << tjGetErrorStr() << std::endl;
     }
 
+    const tjscalingfactor scalingFactor = { static_cast<int>(m_scalingNum), static_cast<int>(m_scalingDenom) };
+    const uint32_t scaledWidth = TJSCALED(jpegWidth, scalingFactor);
+    const uint32_t scaledHeight = TJSCALED(jpegHeight, scalingFactor);
+
     // check whether the RGB buffer is big enough
-    const auto requiredRgbBufferSize = jpegWidth * jpegHeight * m_pixelSize;
-    if(requiredRgbBufferSize > m_rgbaBufferSize) {
+    const auto requiredRgbBufferSize = scaledWidth * scaledHeight * m_pixelSize;
+    if(requiredRgbBufferSize > frame.bufferSize) {
         std::cerr << "Error: JPEG image size " << jpegWidth << "x" << jpegHeight << " does not fit allocated buffer size." << std::endl;
         std::abort();
     }
     //std::cout << "JPEG: " << jpegWidth << "x" << jpegHeight << std::endl;
 
-    m_width = jpegWidth;
-    m_height = jpegHeight;
+    frame.width = scaledWidth;
+    frame.height = scaledHeight;
+    frame.cropX = 0;
+    frame.cropY = 0;
+    frame.fullWidth = scaledWidth;
+    frame.fullHeight = scaledHeight;
+    frame.isYuv = false;
 
     // TODO: decompress into RGBA to save processing when writing to OpenGL texture
     tjError = tjDecompress2(
         m_jpegDecompressor,
         jpegBuffer, jpegBufferSize,
-        m_rgbaBuffer, 0 /*width*/, 0 /*pitch*/, 0 /*height*/,
+        frame.buffer, scaledWidth, 0 /*pitch*/, scaledHeight,
         TJPF_RGBA, TJFLAG_FASTDCT | TJFLAG_NOREALLOC
     );
     if(tjError != 0) {
         // Avoid endless warning about "Warning: unknown JFIF revision number 2.01"
         //std::cerr << tjGetErrorStr() << std::endl;
     }
+}
 
-    return m_rgbaBuffer;
+void inastitch::jpeg::Decoder::decodeRows(uint8_t *jpegBuffer, uint32_t jpegBufferSize, Frame &frame, uint32_t firstRow)
+{
+    int32_t jpegWidth = 0, jpegHeight = 0, jpegSubsamp = 0;
+    int tjError = 0;
+
+    tjError = tjDecompressHeader2(m_jpegDecompressor, jpegBuffer, jpegBufferSize, &jpegWidth, &jpegHeight, &jpegSubsamp);
+    if(tjError != 0) {
+        // Avoid endless warning about "Warning: unknown JFIF revision number 2.01"
+        //std::cerr << tjGetErrorStr() << std::endl;
+    }
+
+    const tjscalingfactor scalingFactor = { static_cast<int>(m_scalingNum), static_cast<int>(m_scalingDenom) };
+    const uint32_t scaledWidth = TJSCALED(jpegWidth, scalingFactor);
+    const uint32_t scaledHeight = TJSCALED(jpegHeight, scalingFactor);
+
+    // check whether the slice fits in the frame
+    const uint32_t pitch = frame.fullWidth * m_pixelSize;
+    if( (scaledWidth != frame.fullWidth) || ((firstRow + scaledHeight) * pitch > frame.bufferSize) ) {
+        std::cerr << "Error: JPEG slice size " << jpegWidth << "x" << jpegHeight << " does not fit frame." << std::endl;
+        std::abort();
+    }
+
+    tjError = tjDecompress2(
+        m_jpegDecompressor,
+        jpegBuffer, jpegBufferSize,
+        frame.buffer + firstRow * pitch, scaledWidth, pitch, scaledHeight,
+        TJPF_RGBA, TJFLAG_FASTDCT | TJFLAG_NOREALLOC
+    );
+    if(tjError != 0) {
+        // Avoid endless warning about "Warning: unknown JFIF revision number 2.01"
+        //std::cerr << tjGetErrorStr() << std::endl;
+    }
+}
+
+void inastitch::jpeg::Decoder::decodeYuv(uint8_t *jpegBuffer, uint32_t jpegBufferSize, Frame &frame)
+{
+    int32_t jpegWidth = 0, jpegHeight = 0, jpegSubsamp = 0;
+    int tjError = 0;
+
+    tjError = tjDecompressHeader2(m_jpegDecompressor, jpegBuffer, jpegBufferSize, &jpegWidth, &jpegHeight, &jpegSubsamp);
+    if(tjError != 0) {
+        // Avoid endless warning about "Warning: unknown JFIF revision number 2.01"
+        //std::cerr << tjGetErrorStr() << std::endl;
+    }
+
+    const tjscalingfactor scalingFactor = { static_cast<int>(m_scalingNum), static_cast<int>(m_scalingDenom) };
+    const uint32_t scaledWidth = TJSCALED(jpegWidth, scalingFactor);
+    const uint32_t scaledHeight = TJSCALED(jpegHeight, scalingFactor);
+
+    // Grayscale JPEG only has the Y plane
+    const uint32_t jpegPlaneCount = (jpegSubsamp == TJSAMP_GRAY) ? 1 : yuvPlaneCount;
+
+    // check whether the RGB buffer is big enough to hold all planes
+    uint32_t requiredYuvBufferSize = 0;
+    for(uint32_t planeIdx=0; planeIdx<jpegPlaneCount; planeIdx++)
+    {
+        frame.yuvPlaneWidths[planeIdx] = tjPlaneWidth(planeIdx, scaledWidth, jpegSubsamp);
+        frame.yuvPlaneHeights[planeIdx] = tjPlaneHeight(planeIdx, scaledHeight, jpegSubsamp);
+        frame.yuvPlanes[planeIdx] = frame.buffer + requiredYuvBufferSize;
+        requiredYuvBufferSize += frame.yuvPlaneWidths[planeIdx] * frame.yuvPlaneHeights[planeIdx];
+    }
+    // Note: for grayscale, chroma planes are a single neutral pixel
+    for(uint32_t planeIdx=jpegPlaneCount; planeIdx<yuvPlaneCount; planeIdx++)
+    {
+        frame.yuvPlaneWidths[planeIdx] = 1;
+        frame.yuvPlaneHeights[planeIdx] = 1;
+        frame.yuvPlanes[planeIdx] = frame.buffer + requiredYuvBufferSize;
+        requiredYuvBufferSize += 1;
+    }
+    if(requiredYuvBufferSize > frame.bufferSize) {
+        std::cerr << "Error: JPEG image size " << jpegWidth << "x" << jpegHeight << " does not fit allocated buffer size." << std::endl;
+        std::abort();
+    }
+    for(uint32_t planeIdx=jpegPlaneCount; planeIdx<yuvPlaneCount; planeIdx++)
+    {
+        frame.yuvPlanes[planeIdx][0] = 0x80;
+    }
+
+    frame.width = scaledWidth;
+    frame.height = scaledHeight;
+    frame.cropX = 0;
+    frame.cropY = 0;
+    frame.fullWidth = scaledWidth;
+    frame.fullHeight = scaledHeight;
+    frame.isYuv = true;
+
+    // Note: skips color conversion and chroma upsampling,
+    //       both are done by the fragment shader.
+    tjError = tjDecompressToYUVPlanes(
+        m_jpegDecompressor,
+        jpegBuffer, jpegBufferSize,
+        frame.yuvPlanes, scaledWidth, nullptr /*strides*/, scaledHeight,
+        TJFLAG_FASTDCT
+    );
+    if(tjError != 0) {
+        // Avoid endless warning about "Warning: unknown JFIF revision number 2.01"
+        //std::cerr << tjGetErrorStr() << std::endl;
+    }
+}
+
+void inastitch::jpeg::Decoder::setScalingFactor(uint32_t num, uint32_t denom)
+{
+    m_scalingNum = num;
+    m_scalingDenom = denom;
+}
+
+void inastitch::jpeg::Decoder::setCropRegion(float left, float top, float right, float bottom)
+{
+    m_cropLeft = std::max(0.0f, left);
+    m_cropTop = std::max(0.0f, top);
+    m_cropRight = std::min(1.0f, right);
+    m_cropBottom = std::min(1.0f, bottom);
+
+    m_isCropped = (m_cropLeft > 0.0f) || (m_cropTop > 0.0f) || (m_cropRight < 1.0f) || (m_cropBottom < 1.0f);
+
+    if(m_isCropped && (m_jpegCropDecompressor == nullptr))
+    {
+        auto cropDecompressor = new CropDecompressor;
+        cropDecompressor->cinfo.err = jpeg_std_error(&cropDecompressor->jerr);
+        cropDecompressor->jerr.error_exit = cropDecompressorErrorExit;
+        cropDecompressor->jerr.emit_message = cropDecompressorEmitMessage;
+        jpeg_create_decompress(&cropDecompressor->cinfo);
+        cropDecompressor->cinfo.client_data = cropDecompressor;
+
+        m_jpegCropDecompressor = cropDecompressor;
+    }
+}
+
+void inastitch::jpeg::Decoder::decodeCropped(uint8_t *jpegBuffer, uint32_t jpegBufferSize, Frame &frame)
+{
+    auto cropDecompressor = static_cast<CropDecompressor*>(m_jpegCropDecompressor);
+    auto cinfo = &cropDecompressor->cinfo;
+
+    if(setjmp(cropDecompressor->jumpBuffer))
+    {
+        // Note: error is ignored, same as TurboJPEG decoding
+        jpeg_abort_decompress(cinfo);
+        return;
+    }
+
+    jpeg_mem_src(cinfo, jpegBuffer, jpegBufferSize);
+    jpeg_read_header(cinfo, TRUE);
+
+    // same as 'TJPF_RGBA' and 'TJFLAG_FASTDCT'
+    cinfo->out_color_space = JCS_EXT_RGBA;
+    cinfo->dct_method = JDCT_IFAST;
+    cinfo->scale_num = m_scalingNum;
+    cinfo->scale_denom = m_scalingDenom;
+
+    jpeg_start_decompress(cinfo);
+    const uint32_t scaledWidth = cinfo->output_width;
+    const uint32_t scaledHeight = cinfo->output_height;
+
+    JDIMENSION cropX = std::floor(m_cropLeft * scaledWidth);
+    JDIMENSION cropWidth = std::ceil(m_cropRight * scaledWidth) - cropX;
+    const JDIMENSION cropY = std::floor(m_cropTop * scaledHeight);
+    const JDIMENSION cropHeight = std::ceil(m_cropBottom * scaledHeight) - cropY;
+
+    // Note: 'cropX' and 'cropWidth' are extended to the closest iMCU boundary
+    jpeg_crop_scanline(cinfo, &cropX, &cropWidth);
+
+    // check whether the RGB buffer is big enough
+    const auto requiredRgbBufferSize = cropWidth * cropHeight * m_pixelSize;
+    if(requiredRgbBufferSize > frame.bufferSize) {
+        std::cerr << "Error: JPEG image size " << scaledWidth << "x" << scaledHeight << " does not fit allocated buffer size." << std::endl;
+        std::abort();
+    }
+
+    // Note: skipped rows above the region are entropy-decoded but not dequantized nor transformed
+    if(cropY > 0)
+    {
+        jpeg_skip_scanlines(cinfo, cropY);
+    }
+    while(cinfo->output_scanline < cropY + cropHeight)
+    {
+        JSAMPROW rowPtr = frame.buffer + (cinfo->output_scanline - cropY) * cropWidth * m_pixelSize;
+        jpeg_read_scanlines(cinfo, &rowPtr, 1);
+    }
+    // Note: rows below the region are not decoded at all
+    jpeg_abort_decompress(cinfo);
+
+    frame.width = cropWidth;
+    frame.height = cropHeight;
+    frame.cropX = cropX;
+    frame.cropY = cropY;
+    frame.fullWidth = scaledWidth;
+    frame.fullHeight = scaledHeight;
+    frame.isYuv = false;
+}
+
+std::tuple<uint32_t, uint32_t> inastitch::jpeg::Decoder::getBestScalingFactor(float minScale)
+{
+    int scalingFactorCount = 0;
+    const tjscalingfactor *scalingFactors = tjGetScalingFactors(&scalingFactorCount);
+
+    // smallest downscaling factor that is still larger than 'minScale'
+    uint32_t bestNum = 1, bestDenom = 1;
+    for(int i=0; i<scalingFactorCount; i++)
+    {
+        const auto &sf = scalingFactors[i];
+        const bool isDownscaling = (sf.num <= sf.denom);
+        const bool isLargeEnough = (static_cast<float>(sf.num) / sf.denom >= minScale);
+        const bool isSmaller = (sf.num * bestDenom < bestNum * sf.denom);
+        if(isDownscaling && isLargeEnough && isSmaller)
+        {
+            bestNum = sf.num;
+            bestDenom = sf.denom;
+        }
+    }
+
+    return std::make_tuple(bestNum, bestDenom);
 }
 
 void inastitch::jpeg::Decoder::writePpm(const std::string &filename)
 {
-    if(m_pixelSize != 4) {
+    if((m_pixelSize != 4) || m_frame.isYuv) {
         std::cerr << "writePpm: 'pixelSize' not supported" << std::endl;
         std::abort();
     }
@@ -76,16 +354,18 @@ void inastitch::jpeg::Decoder::writePpm(const std::string &filename)
     ppmFile.open(filename);
 
     // PPM header
-    ppmFile << "P6 " << m_width << " " << m_height << " 255" << std::endl;
+    const auto width = m_frame.width;
+    const auto height = m_frame.height;
+    ppmFile << "P6 " << width << " " << height << " 255" << std::endl;
 
     // PPM data
-    for(uint32_t i=0; i<m_height; i++)
+    for(uint32_t i=0; i<height; i++)
     {
-        for(uint32_t j=0; j<m_width; j++)
+        for(uint32_t j=0; j<width; j++)
         {
-            ppmFile << m_rgbaBuffer[(i*m_width+j)*m_pixelSize + 0];
-            ppmFile << m_rgbaBuffer[(i*m_width+j)*m_pixelSize + 1];
-            ppmFile << m_rgbaBuffer[(i*m_width+j)*m_pixelSize + 2];
+            ppmFile << m_rgbaBuffer[(i*width+j)*m_pixelSize + 0];
+            ppmFile << m_rgbaBuffer[(i*width+j)*m_pixelSize + 1];
+            ppmFile << m_rgbaBuffer[(i*width+j)*m_pixelSize + 2];
             // skip alpha channel
         }
     }
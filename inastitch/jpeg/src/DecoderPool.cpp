@@ -0,0 +1,164 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/jpeg/include/DecoderPool.hpp"
+#include "inastitch/jpeg/include/RestartSlicer.hpp"
+
+// Boost includes:
+#include <boost/asio/post.hpp>
+
+// Std includes:
+#include <iostream>
+#include <future>
+
+inastitch::jpeg::DecoderPool::DecoderPool(uint32_t decoderCount, uint32_t sliceThreadCount)
+{
+    // Note: slice threads need their own decoders
+    for(uint32_t i=0; i<decoderCount + sliceThreadCount; i++) {
+        // Note: decoders only write to caller-owned frames
+        m_decoders.push_back( new Decoder(0) );
+    }
+    m_freeDecoders = m_decoders;
+
+    if(sliceThreadCount > 0) {
+        m_sliceThreadPool = std::make_unique<boost::asio::thread_pool>(sliceThreadCount);
+    }
+}
+
+inastitch::jpeg::DecoderPool::~DecoderPool()
+{
+    if(m_sliceThreadPool) {
+        m_sliceThreadPool->join();
+    }
+
+    for(auto decoder : m_decoders) {
+        delete decoder;
+    }
+}
+
+std::shared_ptr<inastitch::jpeg::Frame> inastitch::jpeg::DecoderPool::decode(
+    FramePool &framePool, const Settings &settings,
+    uint8_t* jpegBuffer, uint32_t jpegBufferSize)
+{
+    auto frame = framePool.acquire();
+    decode(*frame, settings, jpegBuffer, jpegBufferSize);
+    return frame;
+}
+
+void inastitch::jpeg::DecoderPool::decode(
+    Frame &frame, const Settings &settings,
+    uint8_t* jpegBuffer, uint32_t jpegBufferSize)
+{
+    // Note: only RGBA and uncropped decoding can be split into slices
+    const bool isCropped = (settings.cropLeft > 0.0f) || (settings.cropTop > 0.0f)
+                        || (settings.cropRight < 1.0f) || (settings.cropBottom < 1.0f);
+    const bool isSliceable = m_sliceThreadPool && (settings.maxSliceCount > 1) && !settings.isYuv && !isCropped;
+    if(isSliceable && decodeSlices(frame, settings, jpegBuffer, jpegBufferSize))
+    {
+        return;
+    }
+
+    Decoder* const decoder = acquireDecoder();
+    decoder->setScalingFactor(settings.scalingNum, settings.scalingDenom);
+    decoder->setCropRegion(settings.cropLeft, settings.cropTop, settings.cropRight, settings.cropBottom);
+    if(settings.isYuv)
+    {
+        decoder->decodeYuv(jpegBuffer, jpegBufferSize, frame);
+    }
+    else
+    {
+        decoder->decode(jpegBuffer, jpegBufferSize, frame);
+    }
+    releaseDecoder(decoder);
+}
+
+bool inastitch::jpeg::DecoderPool::decodeSlices(Frame &frame, const Settings &settings, uint8_t* jpegBuffer, uint32_t jpegBufferSize)
+{
+    RestartSlicer slicer;
+    if(!slicer.parse(jpegBuffer, jpegBufferSize)) {
+        return false;
+    }
+
+    const auto sliceRows = slicer.getSliceRows(settings.maxSliceCount);
+    const uint32_t sliceCount = sliceRows.size() - 1;
+    if(sliceCount < 2) {
+        // restart markers are too far apart
+        return false;
+    }
+
+    // same as 'TJSCALED'
+    const uint32_t scaledWidth = (slicer.width() * settings.scalingNum + settings.scalingDenom - 1) / settings.scalingDenom;
+    const uint32_t scaledHeight = (slicer.height() * settings.scalingNum + settings.scalingDenom - 1) / settings.scalingDenom;
+    const uint32_t pixelSize = 4; // because TJPF_RGBA
+
+    // check whether the frame buffer is big enough
+    if(scaledWidth * scaledHeight * pixelSize > frame.bufferSize) {
+        std::cerr << "Error: JPEG image size " << slicer.width() << "x" << slicer.height() << " does not fit allocated buffer size." << std::endl;
+        std::abort();
+    }
+
+    frame.width = scaledWidth;
+    frame.height = scaledHeight;
+    frame.cropX = 0;
+    frame.cropY = 0;
+    frame.fullWidth = scaledWidth;
+    frame.fullHeight = scaledHeight;
+    frame.isYuv = false;
+
+    auto decodeSlice = [&](uint32_t sliceIdx)
+    {
+        // Note: reused from one frame to the other
+        thread_local std::vector<uint8_t> sliceBuffer;
+        if(sliceBuffer.size() < slicer.maxSliceSize()) {
+            sliceBuffer.resize(slicer.maxSliceSize());
+        }
+
+        const auto sliceSize = slicer.buildSlice(sliceRows[sliceIdx], sliceRows[sliceIdx+1], sliceBuffer.data(), sliceBuffer.size());
+        // Note: slice boundaries are MCU rows, which are a whole number of rows at any scaling factor
+        const uint32_t firstRow = sliceRows[sliceIdx] * slicer.mcuHeight() * settings.scalingNum / settings.scalingDenom;
+
+        Decoder* const decoder = acquireDecoder();
+        decoder->setScalingFactor(settings.scalingNum, settings.scalingDenom);
+        decoder->setCropRegion(0.0f, 0.0f, 1.0f, 1.0f);
+        decoder->decodeRows(sliceBuffer.data(), sliceSize, frame, firstRow);
+        releaseDecoder(decoder);
+    };
+
+    // first slice is decoded by the calling thread
+    std::vector<std::future<void>> sliceFutures;
+    for(uint32_t sliceIdx=1; sliceIdx<sliceCount; sliceIdx++)
+    {
+        auto sliceTask = std::make_shared<std::packaged_task<void()>>([&decodeSlice, sliceIdx]{ decodeSlice(sliceIdx); });
+        sliceFutures.push_back(sliceTask->get_future());
+        boost::asio::post(*m_sliceThreadPool, [sliceTask]{ (*sliceTask)(); });
+    }
+    decodeSlice(0);
+
+    for(auto &sliceFuture : sliceFutures) {
+        sliceFuture.wait();
+    }
+
+    return true;
+}
+
+inastitch::jpeg::Decoder* inastitch::jpeg::DecoderPool::acquireDecoder()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this]{ return !m_freeDecoders.empty(); });
+
+    Decoder* const decoder = m_freeDecoders.back();
+    m_freeDecoders.pop_back();
+    return decoder;
+}
+
+void inastitch::jpeg::DecoderPool::releaseDecoder(Decoder *decoder)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_freeDecoders.push_back(decoder);
+    }
+    m_condition.notify_one();
+}
@@ -24,10 +24,8 @@ inastitch::jpeg::Encoder::~Encoder()
     delete[] m_jpegBuffer;
 }
 
-std::tuple<uint8_t* const, long unsigned int> inastitch::jpeg::Encoder::encode(const uint8_t *rgbaData, uint32_t width, uint32_t height)
+std::tuple<uint8_t* const, long unsigned int> inastitch::jpeg::Encoder::encode(const uint8_t *rgbaData, uint32_t width, uint32_t height, int jpegQuality)
 {
-    const int jpegQuality = 75;
-
     uint8_t* jpegBuffer = m_jpegBuffer;
     long unsigned int jpegSize = 0;
     tjCompress2(m_jpegCompressor, rgbaData, width, 0, height, TJPF_RGBX,
@@ -43,3 +41,15 @@ std::tuple<uint8_t* const, long unsigned int> inastitch::jpeg::Encoder::encode(c
 
     return std::make_tuple(m_jpegBuffer, jpegSize);
 }
+
+std::tuple<uint8_t* const, long unsigned int> inastitch::jpeg::Encoder::encodeYuv(const uint8_t * const yuvPlanes[3], uint32_t width, uint32_t height, int jpegQuality)
+{
+    uint8_t* jpegBuffer = m_jpegBuffer;
+    long unsigned int jpegSize = 0;
+    // Note: color conversion and subsampling were done by the GPU
+    tjCompressFromYUVPlanes(m_jpegCompressor, const_cast<const unsigned char**>(yuvPlanes), width, nullptr, height,
+                            TJSAMP_420, &jpegBuffer, &jpegSize, jpegQuality,
+                            TJFLAG_FASTDCT | TJFLAG_NOREALLOC);
+
+    return std::make_tuple(m_jpegBuffer, jpegSize);
+}
@@ -0,0 +1,192 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/jpeg/include/EncoderPipeline.hpp"
+
+// Std includes:
+#include <algorithm>
+
+inastitch::jpeg::EncoderPipeline::EncoderPipeline(
+    uint32_t workerCount, uint32_t stripCount, uint32_t maxQueueSize,
+    uint32_t maxRgbaBufferSize, uint32_t maxJpegBufferSize,
+    Writer writer, RateController *rateController)
+    : m_stripCount(stripCount)
+    , m_maxJpegBufferSize(maxJpegBufferSize)
+    , m_framePool(maxQueueSize + workerCount, maxRgbaBufferSize)
+    , m_writer(writer)
+    , m_rateController(rateController)
+{
+    for(uint32_t i=0; i<workerCount; i++) {
+        m_encodeThreads.emplace_back(&EncoderPipeline::encodeLoop, this);
+    }
+    m_writeThread = std::thread(&EncoderPipeline::writeLoop, this);
+}
+
+inastitch::jpeg::EncoderPipeline::~EncoderPipeline()
+{
+    flush();
+}
+
+std::shared_ptr<inastitch::jpeg::Frame> inastitch::jpeg::EncoderPipeline::acquireFrame(bool isBlocking)
+{
+    if(isBlocking)
+    {
+        return m_framePool.acquire();
+    }
+
+    auto frame = m_framePool.tryAcquire();
+    if(!frame)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.droppedCount++;
+    }
+    return frame;
+}
+
+void inastitch::jpeg::EncoderPipeline::push(std::shared_ptr<Frame> frame, const FrameInfo &info)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back( Job{ m_nextSeqIdx++, std::move(frame), info, std::chrono::steady_clock::now() } );
+    }
+    m_jobCondition.notify_one();
+}
+
+void inastitch::jpeg::EncoderPipeline::flush()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_isStopping)
+        {
+            return;
+        }
+        m_isStopping = true;
+    }
+    m_jobCondition.notify_all();
+    m_encodedCondition.notify_all();
+
+    // Note: workers drain the queue before stopping
+    for(auto &encodeThread : m_encodeThreads) {
+        encodeThread.join();
+    }
+    m_writeThread.join();
+}
+
+inastitch::jpeg::EncoderPipeline::Stats inastitch::jpeg::EncoderPipeline::stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = m_stats;
+    stats.queueSize = m_jobs.size();
+    stats.avgLatency = (m_stats.encodedCount > 0) ? (m_totalLatency / m_stats.encodedCount) : 0;
+    return stats;
+}
+
+void inastitch::jpeg::EncoderPipeline::encodeLoop()
+{
+    // Note: one turbojpeg handle and output buffer per worker (and per strip)
+    StripEncoder encoder(m_stripCount, m_maxJpegBufferSize);
+
+    while(true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobCondition.wait(lock, [this]{ return !m_jobs.empty() || m_isStopping; });
+            if(m_jobs.empty())
+            {
+                // stopping and nothing left to encode
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        const auto &frame = *job.frame;
+        auto encodeFrame = [&](int quality)
+        {
+            return frame.isYuv ?
+                encoder.encodeYuv(frame.yuvPlanes, frame.width, frame.height, quality) :
+                encoder.encode(frame.buffer, frame.width, frame.height, quality);
+        };
+
+        EncodedFrame encodedFrame;
+        encodedFrame.info = job.info;
+
+        if(m_rateController)
+        {
+            const auto targetSize = m_rateController->getTargetSize(job.info.offTime);
+            int quality = m_rateController->getQuality(targetSize);
+            // Note: JPEG data is always in the encoder buffer
+            auto [ jpegData, jpegSize ] = encodeFrame(quality);
+            m_rateController->update(quality, jpegSize);
+            encodedFrame.encodeCount++;
+
+            // Note: re-encoded at most once, to bound encoding time
+            if(m_rateController->isReencodeNeeded(targetSize, quality, jpegSize))
+            {
+                quality = m_rateController->getQuality(targetSize);
+                jpegSize = std::get<1>(encodeFrame(quality));
+                m_rateController->update(quality, jpegSize);
+                encodedFrame.encodeCount++;
+            }
+
+            encodedFrame.quality = quality;
+            encodedFrame.jpegData = std::make_shared<const std::vector<uint8_t>>(jpegData, jpegData + jpegSize);
+        }
+        else
+        {
+            auto [ jpegData, jpegSize ] = encodeFrame(RateController::defaultQuality);
+            encodedFrame.quality = RateController::defaultQuality;
+            encodedFrame.encodeCount = 1;
+            encodedFrame.jpegData = std::make_shared<const std::vector<uint8_t>>(jpegData, jpegData + jpegSize);
+        }
+
+        // frame can be reused as soon as it is encoded
+        job.frame.reset();
+
+        const uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - job.pushTime).count();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_encodedFrames.emplace(job.seqIdx, std::move(encodedFrame));
+
+            m_stats.encodedCount++;
+            m_stats.lastLatency = latency;
+            m_stats.maxLatency = std::max(m_stats.maxLatency, latency);
+            m_totalLatency += latency;
+        }
+        m_encodedCondition.notify_one();
+    }
+}
+
+void inastitch::jpeg::EncoderPipeline::writeLoop()
+{
+    while(true)
+    {
+        EncodedFrame encodedFrame;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_encodedCondition.wait(lock, [this]{
+                return (m_encodedFrames.count(m_nextWriteSeqIdx) > 0)
+                    || (m_isStopping && (m_nextWriteSeqIdx == m_nextSeqIdx));
+            });
+
+            auto it = m_encodedFrames.find(m_nextWriteSeqIdx);
+            if(it == m_encodedFrames.end())
+            {
+                // stopping and everything was written
+                return;
+            }
+            encodedFrame = std::move(it->second);
+            m_encodedFrames.erase(it);
+            m_nextWriteSeqIdx++;
+        }
+
+        // Note: written out of the lock, encoders keep going meanwhile
+        m_writer(encodedFrame);
+    }
+}
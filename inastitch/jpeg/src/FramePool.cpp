@@ -0,0 +1,59 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/jpeg/include/FramePool.hpp"
+
+inastitch::jpeg::FramePool::FramePool(uint32_t frameCount, uint32_t frameBufferSize)
+    : m_frameBufferSize(frameBufferSize)
+{
+    for(uint32_t i=0; i<frameCount; i++) {
+        m_frames.push_back( new Frame(new uint8_t[m_frameBufferSize], m_frameBufferSize) );
+    }
+    m_freeFrames = m_frames;
+}
+
+inastitch::jpeg::FramePool::~FramePool()
+{
+    for(auto frame : m_frames) {
+        delete[] frame->buffer;
+        delete frame;
+    }
+}
+
+std::shared_ptr<inastitch::jpeg::Frame> inastitch::jpeg::FramePool::acquire()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this]{ return !m_freeFrames.empty(); });
+
+    Frame* const frame = m_freeFrames.back();
+    m_freeFrames.pop_back();
+
+    // Note: frame goes back to the pool instead of being deleted
+    return std::shared_ptr<Frame>(frame, [this](Frame *frame){ release(frame); });
+}
+
+std::shared_ptr<inastitch::jpeg::Frame> inastitch::jpeg::FramePool::tryAcquire()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_freeFrames.empty())
+    {
+        return nullptr;
+    }
+
+    Frame* const frame = m_freeFrames.back();
+    m_freeFrames.pop_back();
+
+    return std::shared_ptr<Frame>(frame, [this](Frame *frame){ release(frame); });
+}
+
+void inastitch::jpeg::FramePool::release(Frame *frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_freeFrames.push_back(frame);
+    }
+    m_condition.notify_one();
+}
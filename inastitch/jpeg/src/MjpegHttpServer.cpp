@@ -0,0 +1,345 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/jpeg/include/MjpegHttpServer.hpp"
+
+// C includes:
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// Std includes:
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+const char boundary[] = "inastitchframe";
+const char partTrailer[] = "\r\n";
+// Note: request is ignored, it only has to fit
+const size_t maxRequestSize = 4096;
+
+void setNonBlocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+} // namespace
+
+inastitch::jpeg::MjpegHttpServer::MjpegHttpServer(const std::string &bindStr, uint32_t maxClientCount)
+    : m_maxClientCount(maxClientCount)
+{
+    // Note: the stream is not authenticated, so it is only served to other hosts when asked for
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    const auto separatorPos = bindStr.rfind(':');
+    const auto portStr = (separatorPos == std::string::npos) ? bindStr : bindStr.substr(separatorPos + 1);
+    char* portEnd = nullptr;
+    const auto port = std::strtoul(portStr.c_str(), &portEnd, 10);
+    if(portStr.empty() || (*portEnd != '\0') || (port == 0) || (port > 65535)) {
+        std::cerr << "Error: HTTP server address '" << bindStr << "' is not '[address:]port'" << std::endl;
+        std::abort();
+    }
+    address.sin_port = htons(port);
+    if( (separatorPos != std::string::npos) &&
+        (inet_pton(AF_INET, bindStr.substr(0, separatorPos).c_str(), &address.sin_addr) != 1) ) {
+        std::cerr << "Error: HTTP server address '" << bindStr << "' has an invalid IPv4 address" << std::endl;
+        std::abort();
+    }
+
+    if( (m_listenFd = socket(AF_INET, SOCK_STREAM, 0)) < 0 )
+    {
+        perror("Error: socket creation failed");
+        std::abort();
+    }
+
+    const int isReuseAddr = 1;
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &isReuseAddr, sizeof(isReuseAddr));
+
+    if( (bind(m_listenFd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0) ||
+        (listen(m_listenFd, 8) < 0) )
+    {
+        perror("Error: HTTP server socket bind failed");
+        std::abort();
+    }
+    setNonBlocking(m_listenFd);
+
+    if( (m_eventFd = eventfd(0, EFD_NONBLOCK)) < 0 )
+    {
+        perror("Error: eventfd creation failed");
+        std::abort();
+    }
+
+    m_serveThread = std::thread(&MjpegHttpServer::serveLoop, this);
+}
+
+inastitch::jpeg::MjpegHttpServer::~MjpegHttpServer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+    }
+    notifyServeLoop();
+    m_serveThread.join();
+
+    for(auto &client : m_clients)
+    {
+        close(client.socketFd);
+    }
+    close(m_eventFd);
+    close(m_listenFd);
+}
+
+void inastitch::jpeg::MjpegHttpServer::publishFrame(JpegBuffer jpegBuffer, uint64_t absTime)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_latestFrame = std::move(jpegBuffer);
+        m_latestAbsTime = absTime;
+        m_latestSeqIdx++;
+    }
+    notifyServeLoop();
+}
+
+uint32_t inastitch::jpeg::MjpegHttpServer::clientCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_clientCount;
+}
+
+uint64_t inastitch::jpeg::MjpegHttpServer::droppedCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_droppedCount;
+}
+
+void inastitch::jpeg::MjpegHttpServer::notifyServeLoop()
+{
+    // Note: EAGAIN means the counter is saturated, i.e., the serve loop is already to be woken up
+    const uint64_t event = 1;
+    if( (write(m_eventFd, &event, sizeof(event)) < 0) && (errno != EAGAIN) )
+    {
+        perror("Error: HTTP server wake up failed");
+    }
+}
+
+void inastitch::jpeg::MjpegHttpServer::serveLoop()
+{
+    std::vector<struct pollfd> pollFds;
+    while(true)
+    {
+        pollFds.clear();
+        pollFds.push_back({ m_listenFd, POLLIN, 0 });
+        pollFds.push_back({ m_eventFd, POLLIN, 0 });
+        for(const auto &client : m_clients)
+        {
+            const bool hasPendingData = !client.prefix.empty() || client.frame;
+            pollFds.push_back({ client.socketFd, static_cast<short>(POLLIN | (hasPendingData ? POLLOUT : 0)), 0 });
+        }
+
+        if(poll(pollFds.data(), pollFds.size(), -1) < 0)
+        {
+            if(errno == EINTR) continue;
+            perror("Error: HTTP server poll failed");
+            return;
+        }
+
+        if(pollFds[1].revents & POLLIN)
+        {
+            // Note: EAGAIN means the event was already consumed
+            uint64_t event;
+            if( (read(m_eventFd, &event, sizeof(event)) < 0) && (errno != EAGAIN) )
+            {
+                perror("Error: HTTP server wake up event cannot be read");
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_isStopping) return;
+        }
+
+        // Note: clients are only added after this loop, so poll results are still in order
+        std::vector<Client> clients;
+        for(uint32_t clientIdx=0; clientIdx<m_clients.size(); clientIdx++)
+        {
+            auto &client = m_clients[clientIdx];
+            const auto revents = pollFds[clientIdx + 2].revents;
+
+            bool isOpen = !(revents & (POLLERR | POLLNVAL));
+            if(isOpen && (revents & (POLLIN | POLLHUP)))
+            {
+                isOpen = readRequest(client);
+            }
+            if(isOpen && client.isStreaming)
+            {
+                // Note: a newer frame may have been published in the meantime
+                if(client.prefix.empty() && !client.frame)
+                {
+                    startFrame(client);
+                }
+                isOpen = writeFrame(client);
+            }
+
+            if(isOpen) {
+                clients.push_back(std::move(client));
+            } else {
+                close(client.socketFd);
+            }
+        }
+        m_clients = std::move(clients);
+
+        if(pollFds[0].revents & POLLIN)
+        {
+            acceptClients();
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_clientCount = m_clients.size();
+    }
+}
+
+void inastitch::jpeg::MjpegHttpServer::acceptClients()
+{
+    int socketFd;
+    while( (socketFd = accept(m_listenFd, nullptr, nullptr)) >= 0 )
+    {
+        if(m_clients.size() >= m_maxClientCount)
+        {
+            close(socketFd);
+            continue;
+        }
+        setNonBlocking(socketFd);
+
+        Client client;
+        client.socketFd = socketFd;
+        m_clients.push_back(std::move(client));
+    }
+}
+
+bool inastitch::jpeg::MjpegHttpServer::readRequest(Client &client)
+{
+    char buffer[1024];
+    while(true)
+    {
+        const auto readSize = recv(client.socketFd, buffer, sizeof(buffer), 0);
+        if(readSize == 0) {
+            // closed by client
+            return false;
+        }
+        if(readSize < 0) {
+            return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR);
+        }
+        if(client.isStreaming) {
+            // Note: nothing expected once streaming
+            continue;
+        }
+
+        client.request.append(buffer, readSize);
+        if(client.request.find("\r\n\r\n") != std::string::npos)
+        {
+            client.isStreaming = true;
+            client.request.clear();
+            client.prefix = std::string("HTTP/1.0 200 OK\r\n")
+                          + "Cache-Control: no-cache\r\n"
+                          + "Pragma: no-cache\r\n"
+                          + "Connection: close\r\n"
+                          + "Content-Type: multipart/x-mixed-replace; boundary=" + boundary + "\r\n"
+                          + "\r\n";
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // Note: a new client starts with the latest frame
+            client.lastFrameSeqIdx = (m_latestSeqIdx > 0) ? m_latestSeqIdx - 1 : 0;
+        }
+        else if(client.request.size() > maxRequestSize)
+        {
+            return false;
+        }
+    }
+}
+
+void inastitch::jpeg::MjpegHttpServer::startFrame(Client &client)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(!m_latestFrame || (m_latestSeqIdx == client.lastFrameSeqIdx))
+    {
+        return;
+    }
+
+    // frames published while sending the previous one are skipped
+    m_droppedCount += m_latestSeqIdx - client.lastFrameSeqIdx - 1;
+    client.lastFrameSeqIdx = m_latestSeqIdx;
+    client.frame = m_latestFrame;
+    client.sentSize = 0;
+    client.prefix += std::string("--") + boundary + "\r\n"
+                   + "Content-Type: image/jpeg\r\n"
+                   + "Content-Length: " + std::to_string(client.frame->size()) + "\r\n"
+                   + "X-Timestamp: " + std::to_string(m_latestAbsTime) + "\r\n"
+                   + "\r\n";
+}
+
+bool inastitch::jpeg::MjpegHttpServer::writeFrame(Client &client)
+{
+    while(!client.prefix.empty() || client.frame)
+    {
+        // Note: headers, shared JPEG data and trailer are sent with one call, skipping what was already sent
+        struct iovec iovecs[3];
+        uint32_t iovecCount = 0;
+        auto addIovec = [&](const void* data, size_t size)
+        {
+            if(size > 0)
+            {
+                iovecs[iovecCount].iov_base = const_cast<void*>(data);
+                iovecs[iovecCount].iov_len = size;
+                iovecCount++;
+            }
+        };
+
+        size_t skipSize = client.sentSize;
+        auto addSkipped = [&](const void* data, size_t size)
+        {
+            const auto skippedSize = std::min(skipSize, size);
+            skipSize -= skippedSize;
+            addIovec(static_cast<const uint8_t*>(data) + skippedSize, size - skippedSize);
+        };
+        addSkipped(client.prefix.data(), client.prefix.size());
+        if(client.frame)
+        {
+            addSkipped(client.frame->data(), client.frame->size());
+            addSkipped(partTrailer, sizeof(partTrailer) - 1);
+        }
+
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = iovecs;
+        message.msg_iovlen = iovecCount;
+        // Note: no SIGPIPE when the client is gone
+        const auto sentSize = sendmsg(client.socketFd, &message, MSG_NOSIGNAL);
+        if(sentSize < 0) {
+            return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR);
+        }
+        client.sentSize += sentSize;
+
+        const size_t totalSize = client.prefix.size() + (client.frame ? client.frame->size() + sizeof(partTrailer) - 1 : 0);
+        if(client.sentSize == totalSize)
+        {
+            client.prefix.clear();
+            client.frame.reset();
+            client.sentSize = 0;
+            startFrame(client);
+        }
+    }
+    return true;
+}
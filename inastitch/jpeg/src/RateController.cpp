@@ -0,0 +1,130 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/jpeg/include/RateController.hpp"
+
+// Std includes:
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+// size doubles every ~28 quality steps in the middle of the range
+const double defaultSlope = 0.025;
+const double minSlope = 0.005;
+const double maxSlope = 0.1;
+// Note: older samples weigh less, so that the model follows scene changes
+const double sampleDecay = 0.8;
+const double smoothingFactor = 0.1;
+// overshoot tolerated before re-encoding
+const double reencodeTolerance = 1.1;
+// Note: only used until the frame time is measured
+const double defaultFrameTime = 1000000.0 / 30;
+
+} // namespace
+
+inastitch::jpeg::RateController::RateController(uint32_t targetFrameSize, uint64_t targetBitrate, bool isReencodeEnabled)
+    : m_targetFrameSize(targetFrameSize)
+    , m_targetBitrate(targetBitrate)
+    , m_isReencodeEnabled(isReencodeEnabled)
+    , m_modelA(0.0)
+    , m_modelB(defaultSlope)
+{ }
+
+uint32_t inastitch::jpeg::RateController::getTargetSize(uint64_t frameTime)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(frameTime > 0)
+    {
+        m_avgFrameTime = (m_avgFrameTime == 0.0) ? frameTime
+                       : (1.0 - smoothingFactor) * m_avgFrameTime + smoothingFactor * frameTime;
+    }
+
+    if(m_targetBitrate == 0)
+    {
+        return m_targetFrameSize;
+    }
+
+    const double avgFrameTime = (m_avgFrameTime > 0.0) ? m_avgFrameTime : defaultFrameTime;
+    return static_cast<uint32_t>(m_targetBitrate / 8.0 * avgFrameTime / 1000000.0);
+}
+
+int inastitch::jpeg::RateController::getQuality(uint32_t targetSize)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(m_samples.empty() || (targetSize == 0))
+    {
+        return defaultQuality;
+    }
+
+    const double quality = (std::log(static_cast<double>(targetSize)) - m_modelA) / m_modelB;
+    return std::clamp(static_cast<int>(std::floor(quality)), minQuality, maxQuality);
+}
+
+bool inastitch::jpeg::RateController::isReencodeNeeded(uint32_t targetSize, int quality, uint32_t jpegSize)
+{
+    if(!m_isReencodeEnabled || (targetSize == 0) || (jpegSize <= targetSize * reencodeTolerance))
+    {
+        return false;
+    }
+
+    // Note: model was updated with the overshooting frame
+    return getQuality(targetSize) < quality;
+}
+
+void inastitch::jpeg::RateController::update(int quality, uint32_t jpegSize)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_samples.push_back( Sample{ quality, std::log(static_cast<double>(std::max<uint32_t>(jpegSize, 1))) } );
+    if(m_samples.size() > maxSampleCount)
+    {
+        m_samples.pop_front();
+    }
+
+    m_avgFrameSize = (m_avgFrameSize == 0.0) ? jpegSize
+                   : (1.0 - smoothingFactor) * m_avgFrameSize + smoothingFactor * jpegSize;
+
+    fitModel();
+}
+
+uint64_t inastitch::jpeg::RateController::getBitrate()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const double avgFrameTime = (m_avgFrameTime > 0.0) ? m_avgFrameTime : defaultFrameTime;
+    return static_cast<uint64_t>(m_avgFrameSize * 8.0 * 1000000.0 / avgFrameTime);
+}
+
+void inastitch::jpeg::RateController::fitModel()
+{
+    // weighted least squares, most recent sample has weight 1
+    double sumW = 0.0, sumQ = 0.0, sumS = 0.0;
+    double weight = 1.0;
+    for(auto it = m_samples.rbegin(); it != m_samples.rend(); ++it, weight *= sampleDecay)
+    {
+        sumW += weight;
+        sumQ += weight * it->quality;
+        sumS += weight * it->logSize;
+    }
+    const double meanQ = sumQ / sumW;
+    const double meanS = sumS / sumW;
+
+    double varQ = 0.0, covQS = 0.0;
+    weight = 1.0;
+    for(auto it = m_samples.rbegin(); it != m_samples.rend(); ++it, weight *= sampleDecay)
+    {
+        varQ += weight * (it->quality - meanQ) * (it->quality - meanQ);
+        covQS += weight * (it->quality - meanQ) * (it->logSize - meanS);
+    }
+
+    // Note: slope is unknown while quality does not vary, and is bounded against noisy samples
+    const double slope = (varQ > 1.0) ? (covQS / varQ) : defaultSlope;
+    m_modelB = std::clamp(slope, minSlope, maxSlope);
+    m_modelA = meanS - m_modelB * meanQ;
+}
@@ -0,0 +1,193 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/jpeg/include/RestartSlicer.hpp"
+
+// Std includes:
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+
+namespace {
+
+uint16_t getBigEndian16(const uint8_t* data)
+{
+    return (static_cast<uint16_t>(data[0]) << 8) | data[1];
+}
+
+} // namespace
+
+bool inastitch::jpeg::RestartSlicer::parse(const uint8_t* jpegBuffer, uint32_t jpegBufferSize)
+{
+    m_jpegBuffer = jpegBuffer;
+    m_jpegBufferSize = jpegBufferSize;
+    m_restartInterval = 0;
+    m_sofHeightOffset = 0;
+    m_scanOffset = 0;
+    m_restartOffsets.clear();
+
+    uint32_t maxHSampling = 1, maxVSampling = 1, componentCount = 0;
+
+    // JPEG header, marker by marker
+    // See: https://www.w3.org/Graphics/JPEG/itu-t81.pdf (Annex B)
+    uint32_t offset = 2; // skip SOI
+    while(m_scanOffset == 0)
+    {
+        if( (offset + 4 > jpegBufferSize) || (jpegBuffer[offset] != 0xFF) ) {
+            return false;
+        }
+        const uint8_t marker = jpegBuffer[offset + 1];
+        if(marker == 0xFF) {
+            // fill byte
+            offset++;
+            continue;
+        }
+
+        const uint32_t segmentLength = getBigEndian16(jpegBuffer + offset + 2);
+        const uint32_t segmentEnd = offset + 2 + segmentLength;
+        if(segmentEnd > jpegBufferSize) {
+            return false;
+        }
+
+        switch(marker)
+        {
+        case 0xC0: // SOF0, baseline
+        case 0xC1: // SOF1, extended sequential
+            {
+                m_sofHeightOffset = offset + 5;
+                m_height = getBigEndian16(jpegBuffer + offset + 5);
+                m_width = getBigEndian16(jpegBuffer + offset + 7);
+                componentCount = jpegBuffer[offset + 9];
+                for(uint32_t c=0; c<componentCount; c++)
+                {
+                    const uint8_t sampling = jpegBuffer[offset + 10 + c*3 + 1];
+                    maxHSampling = std::max<uint32_t>(maxHSampling, sampling >> 4);
+                    maxVSampling = std::max<uint32_t>(maxVSampling, sampling & 0x0F);
+                }
+            }
+            break;
+        case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+        case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+            // progressive, lossless or arithmetic
+            return false;
+        case 0xDD: // DRI
+            m_restartInterval = getBigEndian16(jpegBuffer + offset + 4);
+            break;
+        case 0xDA: // SOS
+            if(jpegBuffer[offset + 4] != componentCount) {
+                // not interleaved, i.e., one scan per component
+                return false;
+            }
+            m_scanOffset = segmentEnd;
+            break;
+        default:
+            break;
+        }
+
+        offset = segmentEnd;
+    }
+
+    if( (m_sofHeightOffset == 0) || (m_restartInterval == 0) || (m_width == 0) || (m_height == 0) ) {
+        return false;
+    }
+
+    // Note: a scan with a single component is not interleaved, its MCU is one 8x8 block
+    const uint32_t mcuWidth = (componentCount == 1) ? 8 : 8 * maxHSampling;
+    m_mcuHeight = (componentCount == 1) ? 8 : 8 * maxVSampling;
+    m_mcuPerRow = (m_width + mcuWidth - 1) / mcuWidth;
+    m_mcuRowCount = (m_height + m_mcuHeight - 1) / m_mcuHeight;
+
+    // entropy-coded data, looking for RSTn and EOI markers
+    m_eoiOffset = jpegBufferSize;
+    for(uint32_t i=m_scanOffset; i+1<jpegBufferSize; i++)
+    {
+        if(jpegBuffer[i] != 0xFF) continue;
+
+        const uint8_t marker = jpegBuffer[i + 1];
+        if(marker == 0x00 || marker == 0xFF) {
+            // bit stuffing or fill byte
+            continue;
+        }
+        if(marker >= 0xD0 && marker <= 0xD7) {
+            m_restartOffsets.push_back(i);
+            i++;
+            continue;
+        }
+        if(marker == 0xD9) {
+            m_eoiOffset = i;
+            break;
+        }
+
+        // any other marker (e.g., DNL, next scan)
+        return false;
+    }
+
+    return !m_restartOffsets.empty();
+}
+
+std::vector<uint32_t> inastitch::jpeg::RestartSlicer::getSliceRows(uint32_t maxSliceCount) const
+{
+    // row 'r' starts with a restart marker when 'r * m_mcuPerRow' is a multiple of the restart interval
+    const uint32_t rowStep = m_restartInterval / std::gcd(m_restartInterval, m_mcuPerRow);
+
+    std::vector<uint32_t> sliceRows = { 0 };
+    for(uint32_t sliceIdx=1; sliceIdx<maxSliceCount; sliceIdx++)
+    {
+        const uint32_t idealRow = (sliceIdx * m_mcuRowCount + maxSliceCount/2) / maxSliceCount;
+        const uint32_t row = ((idealRow + rowStep/2) / rowStep) * rowStep;
+
+        // restart marker must have been found
+        const uint32_t restartIdx = row * m_mcuPerRow / m_restartInterval;
+        const bool isRestartFound = (restartIdx >= 1) && (restartIdx - 1 < m_restartOffsets.size());
+
+        if( (row > sliceRows.back()) && (row < m_mcuRowCount) && isRestartFound )
+        {
+            sliceRows.push_back(row);
+        }
+    }
+    sliceRows.push_back(m_mcuRowCount);
+
+    return sliceRows;
+}
+
+uint32_t inastitch::jpeg::RestartSlicer::buildSlice(uint32_t firstRow, uint32_t endRow, uint8_t* sliceBuffer, uint32_t sliceBufferSize) const
+{
+    // index of the first restart interval of the slice, and of the one after the slice
+    const uint32_t firstIntervalIdx = firstRow * m_mcuPerRow / m_restartInterval;
+    const uint32_t endIntervalIdx = endRow * m_mcuPerRow / m_restartInterval;
+
+    // Note: interval 'i' (with i > 0) starts right after restart marker 'i - 1'
+    const uint32_t dataBegin = (firstRow == 0) ? m_scanOffset : m_restartOffsets.at(firstIntervalIdx - 1) + 2;
+    const uint32_t dataEnd = (endRow == m_mcuRowCount) ? m_eoiOffset : m_restartOffsets.at(endIntervalIdx - 1);
+
+    const uint32_t sliceSize = m_scanOffset + (dataEnd - dataBegin) + 2;
+    if(sliceSize > sliceBufferSize) {
+        return 0;
+    }
+
+    // header, with the height of the slice
+    std::memcpy(sliceBuffer, m_jpegBuffer, m_scanOffset);
+    const uint32_t sliceHeight = (endRow == m_mcuRowCount) ? (m_height - firstRow * m_mcuHeight) : ((endRow - firstRow) * m_mcuHeight);
+    sliceBuffer[m_sofHeightOffset] = sliceHeight >> 8;
+    sliceBuffer[m_sofHeightOffset + 1] = sliceHeight & 0xFF;
+
+    // entropy-coded data
+    uint8_t* const sliceData = sliceBuffer + m_scanOffset;
+    std::memcpy(sliceData, m_jpegBuffer + dataBegin, dataEnd - dataBegin);
+
+    // restart markers are renumbered, since decoder expects RST0 first
+    for(uint32_t restartIdx=firstIntervalIdx; (restartIdx < m_restartOffsets.size()) && (m_restartOffsets.at(restartIdx) < dataEnd); restartIdx++)
+    {
+        const uint32_t markerOffset = m_restartOffsets.at(restartIdx) - dataBegin;
+        sliceData[markerOffset + 1] = 0xD0 + ((restartIdx - firstIntervalIdx) % 8);
+    }
+
+    // EOI
+    sliceBuffer[sliceSize - 2] = 0xFF;
+    sliceBuffer[sliceSize - 1] = 0xD9;
+
+    return sliceSize;
+}
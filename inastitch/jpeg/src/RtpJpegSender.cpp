@@ -0,0 +1,331 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/jpeg/include/RtpJpegSender.hpp"
+
+// C includes:
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+// Std includes:
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <algorithm>
+
+namespace {
+
+uint16_t getBigEndian16(const uint8_t* data)
+{
+    return (static_cast<uint16_t>(data[0]) << 8) | data[1];
+}
+
+uint8_t* put8(uint8_t* data, uint8_t value)
+{
+    data[0] = value;
+    return data + 1;
+}
+
+uint8_t* put16(uint8_t* data, uint16_t value)
+{
+    data[0] = value >> 8;
+    data[1] = value & 0xFF;
+    return data + 2;
+}
+
+uint8_t* put24(uint8_t* data, uint32_t value)
+{
+    data[0] = (value >> 16) & 0xFF;
+    return put16(data + 1, value & 0xFFFF);
+}
+
+uint8_t* put32(uint8_t* data, uint32_t value)
+{
+    data = put16(data, value >> 16);
+    return put16(data, value & 0xFFFF);
+}
+
+} // namespace
+
+inastitch::jpeg::RtpJpegSender::RtpJpegSender(const std::vector<std::string> &destinationStrs, uint64_t maxBitrate)
+    : m_sequenceNumber( std::random_device()() & 0xFFFF )
+    , m_syncSourceId( std::random_device()() )
+    , m_byteRate( maxBitrate / 8 )
+    // Note: burst of a few packets, so that the receiver never gets more than that at once
+    , m_maxTokens( maxBatchSize / 4 * maxPacketSize )
+    , m_tokens( m_maxTokens )
+    , m_lastRefillTime( std::chrono::steady_clock::now() )
+{
+    // SOCK_DGRAM = UDP
+    if( (m_socketFd = socket(AF_INET, SOCK_DGRAM, 0)) < 0 )
+    {
+        perror("Error: socket creation failed");
+        std::abort();
+    }
+
+    for(const auto &destinationStr : destinationStrs)
+    {
+        const auto separatorPos = destinationStr.rfind(':');
+        if(separatorPos == std::string::npos) {
+            std::cerr << "Error: RTP destination '" << destinationStr << "' is not 'address:port'" << std::endl;
+            std::abort();
+        }
+
+        struct sockaddr_in destination;
+        memset(&destination, 0, sizeof(destination));
+        destination.sin_family = AF_INET;
+        destination.sin_port = htons(std::stoi(destinationStr.substr(separatorPos + 1)));
+        if(inet_pton(AF_INET, destinationStr.substr(0, separatorPos).c_str(), &destination.sin_addr) != 1) {
+            std::cerr << "Error: RTP destination '" << destinationStr << "' has an invalid IPv4 address" << std::endl;
+            std::abort();
+        }
+
+        if(IN_MULTICAST(ntohl(destination.sin_addr.s_addr)))
+        {
+            // Note: stays on the local network
+            const uint8_t multicastTtl = 1;
+            if(setsockopt(m_socketFd, IPPROTO_IP, IP_MULTICAST_TTL, &multicastTtl, sizeof(multicastTtl)) < 0) {
+                perror("Error: socket multicast TTL failed");
+                std::abort();
+            }
+        }
+
+        m_destinations.push_back(destination);
+        std::cout << "Sending RTP/JPEG to " << destinationStr << std::endl;
+    }
+}
+
+inastitch::jpeg::RtpJpegSender::~RtpJpegSender()
+{
+    close(m_socketFd);
+}
+
+bool inastitch::jpeg::RtpJpegSender::sendFrame(const uint8_t* jpegBuffer, uint32_t jpegBufferSize, uint64_t absTime)
+{
+    // Find tables, frame size and entropy-coded data in the JPEG header
+    // See: https://www.w3.org/Graphics/JPEG/itu-t81.pdf (Annex B)
+    const uint8_t* quantTables[maxQuantTableCount] = { nullptr, nullptr };
+    uint32_t width = 0, height = 0, restartInterval = 0;
+    int32_t rtpJpegType = -1;
+    uint32_t scanOffset = 0;
+
+    uint32_t offset = 2; // skip SOI
+    while(scanOffset == 0)
+    {
+        if( (offset + 4 > jpegBufferSize) || (jpegBuffer[offset] != 0xFF) ) {
+            return false;
+        }
+        const uint8_t marker = jpegBuffer[offset + 1];
+        const uint32_t segmentLength = getBigEndian16(jpegBuffer + offset + 2);
+        const uint32_t segmentEnd = offset + 2 + segmentLength;
+        if(segmentEnd > jpegBufferSize) {
+            return false;
+        }
+
+        switch(marker)
+        {
+        case 0xDB: // DQT
+            for(uint32_t tableOffset = offset + 4; tableOffset < segmentEnd; tableOffset += 1 + 64)
+            {
+                const uint8_t precision = jpegBuffer[tableOffset] >> 4;
+                const uint8_t tableId = jpegBuffer[tableOffset] & 0x0F;
+                // Note: only 8-bit tables, as the receiver
+                if( (precision != 0) || (tableId >= maxQuantTableCount) ) {
+                    return false;
+                }
+                quantTables[tableId] = jpegBuffer + tableOffset + 1;
+            }
+            break;
+        case 0xC0: // SOF0, baseline
+            {
+                height = getBigEndian16(jpegBuffer + offset + 5);
+                width = getBigEndian16(jpegBuffer + offset + 7);
+                const uint8_t componentCount = jpegBuffer[offset + 9];
+                const uint8_t lumaSampling = jpegBuffer[offset + 11];
+                // RTP/JPEG type 0 is 4:2:2, type 1 is 4:2:0
+                if(componentCount == 3) {
+                    if(lumaSampling == 0x21) rtpJpegType = 0;
+                    if(lumaSampling == 0x22) rtpJpegType = 1;
+                }
+            }
+            break;
+        case 0xDD: // DRI
+            restartInterval = getBigEndian16(jpegBuffer + offset + 4);
+            break;
+        case 0xDA: // SOS
+            scanOffset = segmentEnd;
+            break;
+        default:
+            if( (marker >= 0xC1) && (marker <= 0xCF) && (marker != 0xC4) && (marker != 0xC8) && (marker != 0xCC) ) {
+                // not baseline
+                return false;
+            }
+        }
+        offset = segmentEnd;
+    }
+
+    // Note: RTP/JPEG has an 8-pixel granularity and a 2040-pixel limit
+    if( (rtpJpegType < 0) || (width % 8 != 0) || (height % 8 != 0) || (width > 2040) || (height > 2040) ) {
+        return false;
+    }
+    if( (quantTables[0] == nullptr) || (quantTables[1] == nullptr) ) {
+        return false;
+    }
+
+    // entropy-coded data, without EOI
+    const uint8_t* const scanData = jpegBuffer + scanOffset;
+    uint32_t scanSize = jpegBufferSize - scanOffset;
+    if( (scanSize >= 2) && (scanData[scanSize-2] == 0xFF) && (scanData[scanSize-1] == 0xD9) ) {
+        scanSize -= 2;
+    }
+
+    // 90 kHz clock
+    const uint32_t rtpTimestamp = static_cast<uint32_t>(absTime * 9 / 100);
+
+    m_packets.clear();
+    for(uint32_t fragmentOffset = 0; fragmentOffset < scanSize; )
+    {
+        m_packets.emplace_back();
+        auto &packet = m_packets.back();
+        uint8_t* header = packet.header;
+
+        // RTP (RFC3550)
+        header = put8(header, 0x80); // V=2, P=0, X=0, CC=0
+        header = put8(header, 26);   // M=0, PT=26 (JPEG)
+        header = put16(header, m_sequenceNumber++);
+        header = put32(header, rtpTimestamp);
+        header = put32(header, m_syncSourceId);
+
+        // RTP/JPEG (RFC2435), Q=255 for in-band quantization tables
+        header = put8(header, 0); // type-specific
+        header = put24(header, fragmentOffset);
+        header = put8(header, rtpJpegType + ((restartInterval > 0) ? 64 : 0));
+        header = put8(header, 255);
+        header = put8(header, width / 8);
+        header = put8(header, height / 8);
+
+        if(restartInterval > 0)
+        {
+            // Note: F=1, L=1 and count=0x3FFF, i.e., packets are not aligned to restart intervals
+            header = put16(header, restartInterval);
+            header = put16(header, 0xFFFF);
+        }
+
+        if(fragmentOffset == 0)
+        {
+            // quantization tables, in the first packet only
+            header = put8(header, 0); // MBZ
+            header = put8(header, 0); // precision (8-bit)
+            header = put16(header, 64 * maxQuantTableCount);
+            for(uint32_t tableIdx=0; tableIdx<maxQuantTableCount; tableIdx++)
+            {
+                memcpy(header, quantTables[tableIdx], 64);
+                header += 64;
+            }
+        }
+
+        packet.headerSize = header - packet.header;
+        packet.payload = scanData + fragmentOffset;
+        packet.payloadSize = std::min(scanSize - fragmentOffset, maxPacketSize - packet.headerSize);
+        fragmentOffset += packet.payloadSize;
+    }
+
+    if(m_packets.empty()) {
+        return false;
+    }
+
+    // marker bit is set on the last packet of the frame
+    m_packets.back().header[1] |= 0x80;
+
+    sendPackets();
+    return true;
+}
+
+void inastitch::jpeg::RtpJpegSender::sendPackets()
+{
+    struct mmsghdr messages[maxBatchSize];
+    struct iovec iovecs[maxBatchSize][2];
+
+    const uint32_t messageCount = m_packets.size() * m_destinations.size();
+    for(uint32_t messageIdx = 0; messageIdx < messageCount; )
+    {
+        // batch as many packets as the token bucket allows
+        uint32_t batchSize = 0, batchBytes = 0;
+        while( (batchSize < maxBatchSize) && (messageIdx + batchSize < messageCount) )
+        {
+            const auto &packet = m_packets[(messageIdx + batchSize) / m_destinations.size()];
+            const uint32_t packetSize = packet.headerSize + packet.payloadSize;
+            if( (batchSize > 0) && (m_byteRate > 0) && (batchBytes + packetSize > m_maxTokens) ) {
+                break;
+            }
+            batchSize++;
+            batchBytes += packetSize;
+        }
+        waitForTokens(batchBytes);
+
+        for(uint32_t batchIdx=0; batchIdx<batchSize; batchIdx++)
+        {
+            const auto packetIdx = (messageIdx + batchIdx) / m_destinations.size();
+            const auto destinationIdx = (messageIdx + batchIdx) % m_destinations.size();
+            auto &packet = m_packets[packetIdx];
+
+            // Note: payload is not copied
+            iovecs[batchIdx][0].iov_base = packet.header;
+            iovecs[batchIdx][0].iov_len = packet.headerSize;
+            iovecs[batchIdx][1].iov_base = const_cast<uint8_t*>(packet.payload);
+            iovecs[batchIdx][1].iov_len = packet.payloadSize;
+
+            memset(&messages[batchIdx], 0, sizeof(messages[batchIdx]));
+            messages[batchIdx].msg_hdr.msg_name = &m_destinations[destinationIdx];
+            messages[batchIdx].msg_hdr.msg_namelen = sizeof(m_destinations[destinationIdx]);
+            messages[batchIdx].msg_hdr.msg_iov = iovecs[batchIdx];
+            messages[batchIdx].msg_hdr.msg_iovlen = 2;
+        }
+
+        uint32_t sentCount = 0;
+        while(sentCount < batchSize)
+        {
+            const int result = sendmmsg(m_socketFd, messages + sentCount, batchSize - sentCount, 0);
+            if(result < 0) {
+                // Note: frame is lost, but not the stream
+                perror("Error: RTP/JPEG send failed");
+                break;
+            }
+            sentCount += result;
+        }
+
+        m_sentPacketCount += sentCount;
+        messageIdx += batchSize;
+    }
+}
+
+void inastitch::jpeg::RtpJpegSender::waitForTokens(uint32_t byteCount)
+{
+    if(m_byteRate == 0) {
+        return;
+    }
+
+    for(;;)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const double elapsedTime = std::chrono::duration<double>(now - m_lastRefillTime).count();
+        m_tokens = std::min(m_maxTokens, m_tokens + elapsedTime * m_byteRate);
+        m_lastRefillTime = now;
+
+        if(m_tokens >= byteCount) {
+            m_tokens -= byteCount;
+            return;
+        }
+
+        const double missingTime = (byteCount - m_tokens) / m_byteRate;
+        std::this_thread::sleep_for(std::chrono::duration<double>(missingTime));
+    }
+}
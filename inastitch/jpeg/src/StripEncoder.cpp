@@ -0,0 +1,224 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/jpeg/include/StripEncoder.hpp"
+
+// Boost includes:
+#include <boost/asio/post.hpp>
+
+// Std includes:
+#include <cstring>
+#include <future>
+#include <algorithm>
+
+namespace {
+
+uint16_t getBigEndian16(const uint8_t* data)
+{
+    return (static_cast<uint16_t>(data[0]) << 8) | data[1];
+}
+
+void putBigEndian16(uint8_t* data, uint16_t value)
+{
+    data[0] = value >> 8;
+    data[1] = value & 0xFF;
+}
+
+// Note: returns false if the JPEG is not as produced by turbojpeg (i.e., single-scan baseline)
+bool findSegments(const uint8_t* jpegData, uint32_t jpegSize,
+                  uint32_t &sofHeightOffset, uint32_t &sosOffset, uint32_t &scanOffset)
+{
+    sofHeightOffset = 0;
+    uint32_t offset = 2; // skip SOI
+    while(offset + 4 <= jpegSize)
+    {
+        if(jpegData[offset] != 0xFF) {
+            return false;
+        }
+        const uint8_t marker = jpegData[offset + 1];
+        const uint32_t segmentEnd = offset + 2 + getBigEndian16(jpegData + offset + 2);
+
+        if(marker == 0xC0) {
+            // SOF0
+            sofHeightOffset = offset + 5;
+        } else if(marker == 0xDD) {
+            // DRI, restart markers are already used
+            return false;
+        } else if(marker == 0xDA) {
+            // SOS
+            sosOffset = offset;
+            scanOffset = segmentEnd;
+            return (sofHeightOffset != 0) && (scanOffset + 2 <= jpegSize);
+        }
+        offset = segmentEnd;
+    }
+    return false;
+}
+
+} // namespace
+
+inastitch::jpeg::StripEncoder::StripEncoder(uint32_t stripCount, uint32_t maxJpegBufferSize)
+    : m_jpegBufferSize( maxJpegBufferSize )
+    , m_jpegBuffer( new uint8_t[m_jpegBufferSize] )
+    , m_strips( stripCount )
+{
+    // Note: each strip can be as large as the whole frame
+    for(uint32_t i=0; i<stripCount; i++) {
+        m_encoders.push_back( std::make_unique<Encoder>(maxJpegBufferSize) );
+    }
+
+    // first strip is encoded by the calling thread
+    if(stripCount > 1) {
+        m_stripThreadPool = std::make_unique<boost::asio::thread_pool>(stripCount - 1);
+    }
+}
+
+inastitch::jpeg::StripEncoder::~StripEncoder()
+{
+    if(m_stripThreadPool) {
+        m_stripThreadPool->join();
+    }
+    delete[] m_jpegBuffer;
+}
+
+std::tuple<uint8_t* const, long unsigned int> inastitch::jpeg::StripEncoder::encode(const uint8_t *rgbaData, uint32_t width, uint32_t height, int jpegQuality)
+{
+    const uint32_t pitch = width * 4; // because TJPF_RGBX
+
+    // 4:2:2, see 'Encoder::encode'
+    return encodeStrips(width, height, 16, 8,
+        [&](Encoder &encoder, uint32_t firstRow, uint32_t endRow)
+        {
+            // Note: data is bottom-up, so the top of the strip is further in the buffer
+            return encoder.encode(rgbaData + (height - endRow) * pitch, width, endRow - firstRow, jpegQuality);
+        }
+    );
+}
+
+std::tuple<uint8_t* const, long unsigned int> inastitch::jpeg::StripEncoder::encodeYuv(const uint8_t * const yuvPlanes[3], uint32_t width, uint32_t height, int jpegQuality)
+{
+    // 4:2:0, see 'Encoder::encodeYuv'
+    return encodeStrips(width, height, 16, 16,
+        [&](Encoder &encoder, uint32_t firstRow, uint32_t endRow)
+        {
+            const uint8_t* const stripPlanes[3] = {
+                yuvPlanes[0] + firstRow * width,
+                yuvPlanes[1] + (firstRow / 2) * (width / 2),
+                yuvPlanes[2] + (firstRow / 2) * (width / 2)
+            };
+            return encoder.encodeYuv(stripPlanes, width, endRow - firstRow, jpegQuality);
+        }
+    );
+}
+
+std::tuple<uint8_t* const, long unsigned int> inastitch::jpeg::StripEncoder::encodeStrips(
+    uint32_t width, uint32_t height, uint32_t mcuWidth, uint32_t mcuHeight, const StripFunc &encodeStrip)
+{
+    // strips are whole MCU rows
+    const uint32_t mcuRowCount = (height + mcuHeight - 1) / mcuHeight;
+    const uint32_t mcuPerRow = (width + mcuWidth - 1) / mcuWidth;
+    const uint32_t stripMcuRows = (mcuRowCount + m_strips.size() - 1) / m_strips.size();
+    const uint32_t stripCount = (mcuRowCount + stripMcuRows - 1) / stripMcuRows;
+    const uint32_t restartInterval = stripMcuRows * mcuPerRow;
+
+    // Note: restart interval is a 16-bit value
+    if( (stripCount < 2) || (restartInterval > 0xFFFF) )
+    {
+        const auto [ jpegData, jpegSize ] = encodeStrip(*m_encoders[0], 0, height);
+        return std::make_tuple(jpegData, jpegSize);
+    }
+
+    auto encodeStripIdx = [&](uint32_t stripIdx)
+    {
+        const uint32_t firstRow = stripIdx * stripMcuRows * mcuHeight;
+        const uint32_t endRow = std::min(height, firstRow + stripMcuRows * mcuHeight);
+        const auto [ jpegData, jpegSize ] = encodeStrip(*m_encoders[stripIdx], firstRow, endRow);
+        m_strips[stripIdx] = Strip{ jpegData, static_cast<uint32_t>(jpegSize) };
+    };
+
+    std::vector<std::future<void>> stripFutures;
+    for(uint32_t stripIdx=1; stripIdx<stripCount; stripIdx++)
+    {
+        auto stripTask = std::make_shared<std::packaged_task<void()>>([&encodeStripIdx, stripIdx]{ encodeStripIdx(stripIdx); });
+        stripFutures.push_back(stripTask->get_future());
+        boost::asio::post(*m_stripThreadPool, [stripTask]{ (*stripTask)(); });
+    }
+    encodeStripIdx(0);
+
+    for(auto &stripFuture : stripFutures) {
+        stripFuture.wait();
+    }
+
+    const uint32_t jpegSize = joinStrips(stripCount, height, restartInterval);
+
+    if(jpegSize == 0)
+    {
+        // Note: should not happen with turbojpeg output
+        const auto [ jpegData, jpegSize ] = encodeStrip(*m_encoders[0], 0, height);
+        return std::make_tuple(jpegData, jpegSize);
+    }
+
+    return std::make_tuple(m_jpegBuffer, jpegSize);
+}
+
+uint32_t inastitch::jpeg::StripEncoder::joinStrips(uint32_t stripCount, uint32_t height, uint32_t restartInterval)
+{
+    // Strip JPEGs are:    SOI, tables, SOF, SOS, entropy-coded data, EOI.
+    // Joined JPEG is:     SOI, tables, SOF (full height), DRI, SOS,
+    //                     strip 0 data, RST0, strip 1 data, RST1, ..., EOI.
+    uint32_t sofHeightOffset, sosOffset, scanOffset;
+    if(!findSegments(m_strips[0].jpegData, m_strips[0].jpegSize, sofHeightOffset, sosOffset, scanOffset)) {
+        return 0;
+    }
+
+    const uint32_t driSize = 6;
+    uint32_t jpegSize = scanOffset + driSize;
+    if(jpegSize > m_jpegBufferSize) {
+        return 0;
+    }
+
+    // header of the first strip, with DRI inserted before SOS
+    memcpy(m_jpegBuffer, m_strips[0].jpegData, sosOffset);
+    putBigEndian16(m_jpegBuffer + sofHeightOffset, height);
+    uint8_t* const dri = m_jpegBuffer + sosOffset;
+    dri[0] = 0xFF;
+    dri[1] = 0xDD;
+    putBigEndian16(dri + 2, 4);
+    putBigEndian16(dri + 4, restartInterval);
+    memcpy(m_jpegBuffer + sosOffset + driSize, m_strips[0].jpegData + sosOffset, scanOffset - sosOffset);
+
+    for(uint32_t stripIdx=0; stripIdx<stripCount; stripIdx++)
+    {
+        const auto &strip = m_strips[stripIdx];
+
+        uint32_t stripSofHeightOffset, stripSosOffset, stripScanOffset;
+        if(!findSegments(strip.jpegData, strip.jpegSize, stripSofHeightOffset, stripSosOffset, stripScanOffset)) {
+            return 0;
+        }
+        // Note: without EOI
+        const uint32_t scanSize = strip.jpegSize - 2 - stripScanOffset;
+
+        if(jpegSize + 2 + scanSize + 2 > m_jpegBufferSize) {
+            return 0;
+        }
+
+        if(stripIdx > 0)
+        {
+            // RSTn, n is modulo 8
+            m_jpegBuffer[jpegSize++] = 0xFF;
+            m_jpegBuffer[jpegSize++] = 0xD0 + ((stripIdx - 1) % 8);
+        }
+
+        memcpy(m_jpegBuffer + jpegSize, strip.jpegData + stripScanOffset, scanSize);
+        jpegSize += scanSize;
+    }
+
+    // EOI
+    m_jpegBuffer[jpegSize++] = 0xFF;
+    m_jpegBuffer[jpegSize++] = 0xD9;
+
+    return jpegSize;
+}
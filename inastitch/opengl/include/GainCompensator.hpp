@@ -0,0 +1,69 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Std includes:
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace inastitch {
+namespace opengl {
+
+class WarpMesh;
+
+
+// Exposure and color compensation between input streams, from their mean color where they overlap in the output.
+// Each stream is rendered alone at low resolution, into its own layer of a texture array that is read back
+// asynchronously. Per-stream gains are then solved (least squares, as in Brown & Lowe "Automatic Panoramic Image
+// Stitching using Invariant Features") and smoothed over time, to be applied by the stitching shader.
+// Note: all methods must be called from the thread owning the OpenGL context.
+class GainCompensator
+{
+public:
+    // red, green and blue gains (last one is unused)
+    using Gain = std::array<float, 4>;
+
+public:
+    // Note: 'width' x 'height' is the resolution of the statistics, i.e., of the whole output
+    GainCompensator(uint32_t streamCount, uint32_t width, uint32_t height, uint32_t frameInterval);
+    ~GainCompensator();
+
+public:
+    // Renders the streams every 'frameInterval' frames, and solves the gains once the read back is complete.
+    // Note: to be called with the stitching program, textures and uniforms bound, the gains of the frame
+    //       being the current ones. Framebuffer and viewport are restored.
+    void update(const WarpMesh &warpMesh);
+
+    const Gain& gain(uint32_t streamIdx) const
+    {
+        return m_gains[streamIdx];
+    }
+
+private:
+    void solve(const uint8_t* pixels);
+
+private:
+    const uint32_t m_streamCount;
+    const uint32_t m_width;
+    const uint32_t m_height;
+    const uint32_t m_frameInterval;
+    uint32_t m_frameCount = 0;
+
+    std::vector<Gain> m_gains;
+    // gains applied when the statistics were rendered
+    std::vector<Gain> m_renderGains;
+
+    uint32_t m_texture;
+    std::vector<uint32_t> m_framebuffers;
+    uint32_t m_pbo;
+    // Note: nullptr when no read back is pending
+    void* m_fence = nullptr;
+};
+
+
+} // namespace opengl
+} // namespace inastitch
@@ -0,0 +1,44 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Std includes:
+#include <cstdint>
+
+namespace inastitch {
+namespace opengl {
+
+
+// OpenGL ES 3 context without window (e.g., on a server without display), rendering into a framebuffer object.
+// Note: EGL surfaceless platform is used when available (e.g., Mesa), a pbuffer surface otherwise.
+//       There is no buffer swap, so nothing is tied to a display refresh rate.
+class HeadlessContext
+{
+public:
+    // Note: context is made current and its framebuffer is bound
+    HeadlessContext(uint32_t width, uint32_t height);
+    ~HeadlessContext();
+
+public:
+    uint32_t framebuffer() const
+    {
+        return m_framebuffer;
+    }
+
+private:
+    // Note: stored as void* to avoid including EGL headers
+    void* m_display;
+    void* m_surface;
+    void* m_context;
+
+    uint32_t m_colorRenderbuffer;
+    uint32_t m_depthRenderbuffer;
+    uint32_t m_framebuffer;
+};
+
+
+} // namespace opengl
+} // namespace inastitch
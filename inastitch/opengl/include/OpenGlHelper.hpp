@@ -5,10 +5,11 @@
 
 #pragma once
 
+// GLM includes:
+#include <glm/glm.hpp>
+
 // Std includes:
 #include <stdint.h>
-#include <vector>
-#include <array>
 
 namespace inastitch
 {
@@ -32,34 +33,31 @@ void checkError(const char*, const char*, int);
 
 int getShaderProgram(const char*, const char*);
 
-class Overlay
+struct TextureFootprint
 {
-public:
-    Overlay(uint32_t width, uint32_t height);
-    ~Overlay();
-
-public:
-    void clear();
-    void putChar(uint32_t xOffset, uint32_t yOffset, uint8_t asciiCode);
-    void putDigit(uint32_t xOffset, uint32_t yOffset, uint8_t digit);
-    void putNumber(uint32_t xOffset, uint32_t yOffset, uint32_t number, uint8_t digitCount);
-    void putString(uint32_t xOffset, uint32_t yOffset, const char * const string, uint8_t charCount);
+    bool isVisible = false;
 
-public:
-    uint8_t* rgbaBuffer() const
-    {
-        return m_rgbaBuffer;
-    }
+    // bounding box of the visible part of the quad in the output
+    // Note: in pixels, in OpenGL window coordinates (i.e., origin is bottom left)
+    glm::vec2 screenMin, screenMax;
 
-private:
-    uint32_t m_width;
-    uint32_t m_height;
-    uint8_t* m_rgbaBuffer;
+    // bounding box of the texture coordinates sampled by the visible part of the quad
+    // Note: same space as the fragment shader, i.e. after the warp matrix and lens distortion
+    glm::vec2 texMin, texMax;
 
-private:
-    static const std::vector<std::array<uint8_t, 25>> digitBits;
+    // maximum count of output pixels per texture pixel,
+    // i.e., the texture can be downscaled by this factor with no visible loss
+    float maxPixelPerTexel = 0.0f;
 };
 
+// Note: the quad is given as a grid of ('gridWidth' + 1) x ('gridHeight' + 1) points, row by row,
+//       with their output clip position and texture coordinates (i.e., as rasterized and sampled)
+TextureFootprint getTextureFootprint(
+    uint32_t gridWidth, uint32_t gridHeight,
+    const glm::vec4 *clipPositions, const glm::vec2 *texCoords,
+    uint32_t textureWidth, uint32_t textureHeight,
+    uint32_t outWidth, uint32_t outHeight);
+
 } // helper
 } // namespace opengl
 } // namespace inastitch
@@ -0,0 +1,88 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Local includes:
+#include "inastitch/jpeg/include/FramePool.hpp"
+
+// Std includes:
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace inastitch {
+namespace opengl {
+
+
+// Ring of pixel pack buffers (PBO) that output frames are read back into, without waiting for the GPU.
+// Completed buffers are mapped and handed over as frames, consumers read the pixels in place.
+// Note: all methods must be called from the thread owning the OpenGL context,
+//       only frames can be released by other threads (buffers are unmapped on next 'bind').
+//       The ring must outlive all the frames it gave away.
+class PixelPackRing
+{
+public:
+    PixelPackRing(uint32_t bufferCount, uint32_t bufferSize);
+    ~PixelPackRing();
+
+public:
+    // Binds a free buffer to GL_PIXEL_PACK_BUFFER, returns false if all buffers are in use (i.e., frame is dropped).
+    // Note: when blocking, waits for a mapped frame to be released instead of dropping
+    bool bind(bool isBlocking);
+
+    // Unbinds the buffer and fences the read back issued since 'bind'.
+    void unbind();
+
+    // Maps the oldest buffer read back, returns nullptr if there is none, or if it is not complete and not waiting.
+    // Note: buffer stays mapped until the last reference to the frame is released
+    std::shared_ptr<jpeg::Frame> map(bool isWaiting);
+
+    // Note: unmaps released frames first
+    bool hasFreeBuffer();
+
+    uint64_t droppedCount() const
+    {
+        return m_droppedCount;
+    }
+
+private:
+    void release(uint32_t slotIdx);
+    void recycle();
+
+private:
+    struct Slot
+    {
+        uint32_t pbo = 0;
+        // Note: stored as void* to avoid including OpenGL headers
+        void* fence = nullptr;
+        // only valid while mapped
+        std::optional<jpeg::Frame> frame;
+    };
+
+private:
+    const uint32_t m_bufferSize;
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeSlotIdxs;
+    // read back issued, in order
+    std::deque<uint32_t> m_pendingSlotIdxs;
+    // Note: -1 when no buffer is bound
+    int32_t m_boundSlotIdx = -1;
+    uint32_t m_mappedCount = 0;
+    uint64_t m_droppedCount = 0;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_releaseCondition;
+    std::vector<uint32_t> m_releasedSlotIdxs;
+};
+
+
+} // namespace opengl
+} // namespace inastitch
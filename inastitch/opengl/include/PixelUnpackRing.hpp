@@ -0,0 +1,70 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Local includes:
+#include "inastitch/jpeg/include/FramePool.hpp"
+
+// Std includes:
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace inastitch {
+namespace opengl {
+
+
+// Ring of pixel unpack buffers (PBO) that frames are decoded into,
+// textures being then updated from the PBO without any CPU copy.
+// Note: all methods must be called from the thread owning the OpenGL context,
+//       only the mapped frame buffer can be written by other threads.
+class PixelUnpackRing
+{
+public:
+    PixelUnpackRing(uint32_t bufferCount, uint32_t bufferSize);
+    ~PixelUnpackRing();
+
+public:
+    // Maps the next buffer of the ring, waiting for the GPU to be done with it.
+    // Note: returns the same frame until it is bound for upload, the buffer of a frame is not reused
+    //       while the frame is referenced (nullptr is returned when all of them are).
+    std::shared_ptr<jpeg::Frame> map();
+
+    // Unmaps the frame buffer and binds it to GL_PIXEL_UNPACK_BUFFER,
+    // returns false if the frame is not mapped from this ring.
+    bool bind(const jpeg::Frame &frame);
+
+    // Unbinds the buffer and fences its reuse after the texture updates issued since 'bind'.
+    void unbind();
+
+    // Converts a pointer into the frame buffer to a pixel offset into the bound buffer.
+    static const void* pixelOffset(const jpeg::Frame &frame, const uint8_t* pixels)
+    {
+        return reinterpret_cast<const void*>(static_cast<uintptr_t>(pixels - frame.buffer));
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t pbo = 0;
+        // Note: stored as void* to avoid including OpenGL headers
+        void* fence = nullptr;
+        // Note: shared with the frame holders, its buffer is only valid while mapped
+        std::shared_ptr<jpeg::Frame> frame;
+    };
+
+private:
+    const uint32_t m_bufferSize;
+    std::vector<Slot> m_slots;
+    uint32_t m_nextSlotIdx = 0;
+    // Note: -1 when no buffer is mapped or bound
+    int32_t m_mappedSlotIdx = -1;
+    int32_t m_boundSlotIdx = -1;
+};
+
+
+} // namespace opengl
+} // namespace inastitch
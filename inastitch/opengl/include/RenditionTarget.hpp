@@ -0,0 +1,96 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Local includes:
+#include "inastitch/opengl/include/YuvPacker.hpp"
+
+// Std includes:
+#include <cstdint>
+#include <memory>
+
+namespace inastitch {
+namespace opengl {
+
+
+// Downscaled copy of the rendered frame (e.g., preview or thumbnail), with its own readback.
+// Note: the stitched frame is rendered once, renditions are then blitted from it (or from a larger rendition).
+//       With a depth buffer, the target can also be rendered to (e.g., another view of the same input frames).
+class RenditionTarget
+{
+public:
+    static const auto pboCount = 2;
+
+public:
+    // Note: with 'isYuv', width must be a multiple of 8 and height a multiple of 2 (see "YuvPacker.hpp")
+    RenditionTarget(uint32_t width, uint32_t height, bool isYuv, bool isDepthEnabled = false);
+    ~RenditionTarget();
+
+public:
+    // Scales the color buffer of 'srcFramebuffer' into this rendition (linear filtering).
+    // Note: framebuffer bindings are restored
+    void blitFrom(uint32_t srcFramebuffer, uint32_t srcWidth, uint32_t srcHeight);
+
+    // Starts reading back the current rendition into a free PBO.
+    // Note: as for the stitched frame, pixels are copied later (see 'copyPixels') not to stall the GPU,
+    //       a PBO must be free (i.e., 'pendingCount' less than 'pboCount').
+    void readPixels();
+
+    // Copies the oldest pending readback to 'buffer', returns false if none is pending.
+    // Note: 'buffer' can be nullptr to drop the readback
+    bool copyPixels(uint8_t* buffer);
+
+public:
+    uint32_t framebuffer() const
+    {
+        return m_framebuffer;
+    }
+
+    uint32_t width() const
+    {
+        return m_width;
+    }
+
+    uint32_t height() const
+    {
+        return m_height;
+    }
+
+    // COUNT of readbacks not copied yet
+    uint32_t pendingCount() const
+    {
+        return m_pendingCount;
+    }
+
+    uint32_t bufferSize() const
+    {
+        return m_yuvPacker ? m_yuvPacker->bufferSize() : m_width * m_height * 4;
+    }
+
+    // Note: nullptr when read back as RGBA
+    const YuvPacker* yuvPacker() const
+    {
+        return m_yuvPacker.get();
+    }
+
+private:
+    const uint32_t m_width;
+    const uint32_t m_height;
+    std::unique_ptr<YuvPacker> m_yuvPacker;
+
+    uint32_t m_renderbuffer;
+    // Note: 0 without depth buffer
+    uint32_t m_depthRenderbuffer = 0;
+    uint32_t m_framebuffer;
+    uint32_t m_pboIds[pboCount];
+    // Note: pending readbacks are in the PBOs following 'm_copyPboIdx'
+    uint32_t m_copyPboIdx = 0;
+    uint32_t m_pendingCount = 0;
+};
+
+
+} // namespace opengl
+} // namespace inastitch
@@ -0,0 +1,68 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Std includes:
+#include <cstdint>
+#include <vector>
+#include <array>
+
+namespace inastitch {
+namespace opengl {
+
+
+// Text drawn over the whole output, from a glyph atlas texture (5x5 font, uploaded once)
+// and one instanced quad per glyph, so that the cost does not depend on the output resolution.
+// Note: positions are in pixels of a 'width' x 'height' canvas stretched over the output (origin is top left),
+//       only glyphs that changed since the previous draw are uploaded.
+class TextOverlay
+{
+public:
+    static const uint32_t glyphSize = 5;
+
+public:
+    TextOverlay(uint32_t width, uint32_t height);
+    ~TextOverlay();
+
+public:
+    void clear();
+    void putChar(uint32_t xOffset, uint32_t yOffset, uint8_t asciiCode);
+    void putDigit(uint32_t xOffset, uint32_t yOffset, uint8_t digit);
+    void putNumber(uint32_t xOffset, uint32_t yOffset, uint32_t number, uint8_t digitCount);
+    void putString(uint32_t xOffset, uint32_t yOffset, const char * const string, uint8_t charCount);
+
+    // Draws the glyphs put since 'clear' over the currently bound framebuffer, with alpha blending.
+    // Note: vertex array and texture bindings are reset, but not the shader program
+    void draw();
+
+private:
+    struct Glyph
+    {
+        uint16_t x, y;
+        uint16_t asciiCode;
+        uint16_t padding;
+    };
+
+private:
+    const uint32_t m_width;
+    const uint32_t m_height;
+    std::vector<Glyph> m_glyphs;
+    // copy of the instance buffer
+    std::vector<Glyph> m_uploadedGlyphs;
+    uint32_t m_glyphBufferCapacity = 0;
+
+    uint32_t m_atlasTexture;
+    uint32_t m_shaderProgram;
+    uint32_t m_vertexArray;
+    uint32_t m_glyphBuffer;
+
+private:
+    static const std::vector<std::array<uint8_t, 25>> glyphBits;
+};
+
+
+} // namespace opengl
+} // namespace inastitch
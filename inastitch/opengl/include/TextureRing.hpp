@@ -0,0 +1,75 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Local includes:
+#include "inastitch/jpeg/include/FramePool.hpp"
+#include "inastitch/opengl/include/PixelUnpackRing.hpp"
+
+// Std includes:
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace inastitch {
+namespace opengl {
+
+
+// Ring of texture arrays, with one layer per input stream, each frame being uploaded to the next array of the ring.
+// Note: an array being sampled by the draws of the previous frames is never updated,
+//       so that the upload does not wait for those draws (i.e., CPU and GPU work overlap).
+class TextureRing
+{
+public:
+    // Note: RGBA texture array, or Y, U and V plane texture arrays
+    static const auto maxPlaneCount = jpeg::Frame::yuvPlaneCount;
+
+public:
+    // Note: arrays are allocated once for frames up to 'maxWidth' x 'maxHeight' (i.e., the input stream size),
+    //       since growing an array would discard the layers already uploaded for the frame
+    TextureRing(uint32_t textureCount, uint32_t layerCount, bool isYuv, uint32_t maxWidth, uint32_t maxHeight);
+    ~TextureRing();
+
+public:
+    // Moves to the next texture array(s) of the ring, to be called once per frame before the uploads.
+    void advance();
+
+    // Uploads the decoded region of 'frame' to a layer of the current texture array(s).
+    // Note: with 'pixelUnpackRing', frame is uploaded from its pixel unpack buffer (see "PixelUnpackRing.hpp")
+    void upload(uint32_t layerIdx, const jpeg::Frame &frame, PixelUnpackRing *pixelUnpackRing);
+
+    // Ratio of the last uploaded frame size to the texture size, for luma (x, y) and chroma (z, w).
+    // Note: a smaller frame (see "in-scale-decode") only uses part of its layer
+    const std::array<float, 4>& layerScale(uint32_t layerIdx) const
+    {
+        return m_slots[m_slotIdx].layerScales[layerIdx];
+    }
+
+    // Binds the texture array(s) of the current frame, plane N to texture unit N.
+    // Note: texture unit 0 is left active
+    void bind() const;
+
+private:
+    struct Slot
+    {
+        uint32_t textures[maxPlaneCount] = { 0, 0, 0 };
+        std::vector<std::array<float, 4>> layerScales;
+    };
+
+private:
+    const bool m_isYuv;
+    const uint32_t m_planeCount;
+    const uint32_t m_layerCount;
+    // Note: same size for all planes, since chroma subsampling is only known once decoded
+    const uint32_t m_width;
+    const uint32_t m_height;
+    std::vector<Slot> m_slots;
+    uint32_t m_slotIdx = 0;
+};
+
+
+} // namespace opengl
+} // namespace inastitch
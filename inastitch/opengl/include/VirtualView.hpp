@@ -0,0 +1,73 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// GLM includes:
+#include <glm/glm.hpp>
+
+// Std includes:
+#include <string>
+
+namespace inastitch {
+namespace opengl {
+
+
+// Pan/tilt/zoom view onto the stitched output (i.e., a virtual camera), applied in clip space after the projection.
+// Note: pan and tilt are the view center in output normalized device coordinates (-1 to 1),
+//       zoom is the magnification of the full output (1 shows it all, when the view has the aspect of the output).
+class VirtualView
+{
+public:
+    VirtualView() = default;
+
+public:
+    // Note: format is "PAN,TILT,ZOOM" (or separated by spaces), returns false if invalid
+    static bool parse(const std::string &viewStr, float &pan, float &tilt, float &zoom);
+
+    // Note: zoom is clamped to 1 or more, and the center so that the view stays within the output
+    void set(float pan, float tilt, float zoom);
+
+    // Note: deltas are in view half-size (i.e., 1 moves by half the view), so the pace does not depend on zoom
+    void move(float panDelta, float tiltDelta);
+
+    void scale(float zoomFactor);
+
+    // Note: ratio of the view aspect to the output aspect, the view spans the zoomed output width
+    //       and as much of its height as its own aspect allows
+    void setAspectRatio(float aspectRatio);
+
+    // Transform from output clip coordinates to view clip coordinates.
+    glm::mat4 matrix() const;
+
+    // Checks if a rectangle in output normalized device coordinates is (at least partly) in view.
+    bool isVisible(const glm::vec2 &ndcMin, const glm::vec2 &ndcMax) const;
+
+public:
+    float pan() const
+    {
+        return m_pan;
+    }
+
+    float tilt() const
+    {
+        return m_tilt;
+    }
+
+    float zoom() const
+    {
+        return m_zoom;
+    }
+
+private:
+    float m_pan = 0.0f;
+    float m_tilt = 0.0f;
+    float m_zoom = 1.0f;
+    float m_aspectRatio = 1.0f;
+};
+
+
+} // namespace opengl
+} // namespace inastitch
@@ -0,0 +1,111 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Local includes:
+#include "inastitch/opengl/include/OpenGlHelper.hpp"
+
+// GLM includes:
+#include <glm/glm.hpp>
+
+// Std includes:
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace inastitch {
+namespace opengl {
+
+
+// Tessellated quads of all input streams, with the warp (homography), lens distortion and output projection
+// baked at startup into vertex positions and texture coordinates (i.e., no per-pixel math in the shader).
+// Note: vertex attributes are position (location 0), texture coordinates (location 1) and stream index (location 2).
+class WarpMesh
+{
+public:
+    enum class Projection
+    {
+        // planar output, as rendered by 'projMat'
+        Rectilinear,
+        // vertical lines stay straight, horizontal angle is linear
+        Cylindrical,
+        // horizontal and vertical angles are linear (i.e., equirectangular)
+        Spherical
+    };
+
+    // Brown-Conrady lens model (i.e., as OpenCV), with focal length and optical center in texture coordinates
+    struct Lens
+    {
+        glm::vec2 focal = glm::vec2(1.0f);
+        glm::vec2 center = glm::vec2(0.5f);
+        float k1 = 0.0f, k2 = 0.0f, k3 = 0.0f;
+        float p1 = 0.0f, p2 = 0.0f;
+    };
+
+public:
+    // Note: each quad is split into 'gridWidth' x 'gridHeight' cells
+    WarpMesh(uint32_t streamCount, uint32_t gridWidth, uint32_t gridHeight);
+    ~WarpMesh();
+
+public:
+    // Note: projection name is "rectilinear", "cylindrical" or "spherical", returns false if unknown
+    static bool parseProjection(const std::string &projectionName, Projection &projection);
+
+    // Computes the mesh of one input stream, from the same matrices as the planar rendering.
+    // Note: quad position is linearly mapped from 'posAtUv00' (texCoord 0,0) to 'posAtUv11' (texCoord 1,1),
+    //       'lens' is nullptr for an undistorted stream
+    void bake(uint32_t streamIdx,
+              const glm::mat4 &projMat, const glm::mat4 &viewModelMat, const glm::mat3 &warpMat,
+              const Lens *lens, Projection projection,
+              const glm::vec2 &posAtUv00, const glm::vec2 &posAtUv11);
+
+    // Bounding rectangle of a baked stream, in output normalized device coordinates.
+    // Note: unbounded when part of the stream is behind the viewer
+    void bounds(uint32_t streamIdx, glm::vec2 &ndcMin, glm::vec2 &ndcMax) const;
+
+    // On-screen footprint of a baked stream through 'viewMat' (e.g., the virtual camera), from its vertices,
+    // i.e., with the lens distortion and output projection the stream is drawn with.
+    helper::TextureFootprint footprint(uint32_t streamIdx, const glm::mat4 &viewMat,
+                                       uint32_t textureWidth, uint32_t textureHeight,
+                                       uint32_t outWidth, uint32_t outHeight) const;
+
+    // Uploads the baked meshes to a vertex array, to be called once all streams are baked.
+    void upload();
+
+    // Draws all streams at once.
+    void draw() const;
+
+    // Draws one stream alone.
+    void draw(uint32_t streamIdx) const;
+
+    // Note: distorted texture coordinates of an undistorted point, wrapped as GL_REPEAT
+    static glm::vec2 distort(const Lens &lens, const glm::vec2 &texCoord);
+
+private:
+    struct Vertex
+    {
+        glm::vec4 position;
+        glm::vec2 texCoord;
+        float streamIdx;
+    };
+
+private:
+    const uint32_t m_streamCount;
+    const uint32_t m_gridWidth;
+    const uint32_t m_gridHeight;
+    std::vector<Vertex> m_vertices;
+    std::vector<uint32_t> m_indices;
+    std::vector<glm::vec2> m_boundsMin;
+    std::vector<glm::vec2> m_boundsMax;
+
+    uint32_t m_vertexArray = 0;
+    uint32_t m_vertexBuffer = 0;
+    uint32_t m_indexBuffer = 0;
+};
+
+
+} // namespace opengl
+} // namespace inastitch
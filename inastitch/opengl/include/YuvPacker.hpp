@@ -0,0 +1,80 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Std includes:
+#include <cstdint>
+
+namespace inastitch {
+namespace opengl {
+
+
+// Converts the rendered frame to JFIF YCbCr 4:2:0 planes on the GPU,
+// so that only 1.5 bytes per pixel are read back (instead of 4 for RGBA).
+// Note: each plane is rendered to its own RGBA framebuffer, one RGBA pixel packing 4 plane samples.
+class YuvPacker
+{
+public:
+    static const auto planeCount = 3;
+
+public:
+    // Note: width must be a multiple of 8 and height a multiple of 2
+    YuvPacker(uint32_t width, uint32_t height);
+    ~YuvPacker();
+
+public:
+    // Converts the color buffer of the currently bound framebuffer.
+    // Note: framebuffer, viewport and vertex array bindings are restored, but not the shader program
+    void pack();
+
+    // Reads back the planes one after the other (i.e., I420 layout).
+    // Note: 'buffer' is an offset when a GL_PIXEL_PACK_BUFFER is bound
+    void readPixels(uint8_t* buffer);
+
+public:
+    uint32_t bufferSize() const
+    {
+        return m_planeOffsets[planeCount-1] + m_planeWidths[planeCount-1] * m_planeHeights[planeCount-1];
+    }
+
+    uint32_t planeOffset(uint32_t planeIdx) const
+    {
+        return m_planeOffsets[planeIdx];
+    }
+
+    uint32_t planeWidth(uint32_t planeIdx) const
+    {
+        return m_planeWidths[planeIdx];
+    }
+
+    uint32_t planeHeight(uint32_t planeIdx) const
+    {
+        return m_planeHeights[planeIdx];
+    }
+
+private:
+    const uint32_t m_width;
+    const uint32_t m_height;
+    uint32_t m_planeWidths[planeCount];
+    uint32_t m_planeHeights[planeCount];
+    uint32_t m_planeOffsets[planeCount];
+
+private:
+    // copy of the rendered frame
+    uint32_t m_sceneTexture;
+    uint32_t m_planeTextures[planeCount];
+    uint32_t m_planeFramebuffers[planeCount];
+
+    uint32_t m_shaderProgram;
+    int32_t m_coeffsUni;
+    int32_t m_sampleStepUni;
+    uint32_t m_vertexArray;
+    uint32_t m_vertexBuffer;
+};
+
+
+} // namespace opengl
+} // namespace inastitch
@@ -0,0 +1,295 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/opengl/include/GainCompensator.hpp"
+#include "inastitch/opengl/include/OpenGlHelper.hpp"
+#include "inastitch/opengl/include/WarpMesh.hpp"
+
+// Glfw includes:
+// Use OpenGL ES 3.x
+#define GLFW_INCLUDE_ES3
+#include <GLFW/glfw3.h>
+
+// Std includes:
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+// Note: color values are normalized (0 to 1), see Brown & Lowe for the standard deviations
+const float noiseSigma = 10.0f / 255.0f;
+const float gainSigma = 0.1f;
+const float minGain = 0.5f;
+const float maxGain = 2.0f;
+// fraction of the way to the solved gains per update
+const float smoothingFactor = 0.2f;
+
+// Note: a pixel is covered when its alpha is set, and ignored when saturated (i.e., its true color is unknown)
+const uint8_t minCoveredAlpha = 128;
+const uint8_t maxUnsaturatedValue = 250;
+// overlaps smaller than this are ignored
+const uint32_t minOverlapPixelCount = 16;
+
+// Solves A * x = b by Gaussian elimination with partial pivoting, returns false if A is singular.
+// Note: 'a' (n x n, row-major) and 'b' are modified
+bool solveLinearSystem(std::vector<float> &a, std::vector<float> &b, uint32_t n, std::vector<float> &x)
+{
+    for(uint32_t col=0; col<n; col++)
+    {
+        uint32_t pivot = col;
+        for(uint32_t row=col+1; row<n; row++)
+        {
+            if(std::fabs(a[row * n + col]) > std::fabs(a[pivot * n + col])) {
+                pivot = row;
+            }
+        }
+        if(a[pivot * n + col] == 0.0f)
+        {
+            return false;
+        }
+        if(pivot != col)
+        {
+            std::swap_ranges(a.begin() + pivot * n, a.begin() + (pivot + 1) * n, a.begin() + col * n);
+            std::swap(b[pivot], b[col]);
+        }
+        for(uint32_t row=col+1; row<n; row++)
+        {
+            const float factor = a[row * n + col] / a[col * n + col];
+            for(uint32_t k=col; k<n; k++)
+            {
+                a[row * n + k] -= factor * a[col * n + k];
+            }
+            b[row] -= factor * b[col];
+        }
+    }
+
+    x.resize(n);
+    for(uint32_t row=n; row-- > 0; )
+    {
+        float value = b[row];
+        for(uint32_t k=row+1; k<n; k++)
+        {
+            value -= a[row * n + k] * x[k];
+        }
+        x[row] = value / a[row * n + row];
+    }
+    return true;
+}
+
+} // namespace
+
+inastitch::opengl::GainCompensator::GainCompensator(uint32_t streamCount, uint32_t width, uint32_t height, uint32_t frameInterval)
+    : m_streamCount(streamCount)
+    , m_width(width)
+    , m_height(height)
+    , m_frameInterval(std::max(frameInterval, 1u))
+    , m_gains(streamCount, Gain{ 1.0f, 1.0f, 1.0f, 1.0f })
+    , m_renderGains(m_gains)
+    , m_framebuffers(streamCount)
+{
+    GL_CHECK( glGenTextures(1, &m_texture) );
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture) );
+    GL_CHECK( glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, m_width, m_height, m_streamCount) );
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D_ARRAY, 0) );
+
+    GLint framebuffer;
+    GL_CHECK( glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer) );
+    GL_CHECK( glGenFramebuffers(m_streamCount, m_framebuffers.data()) );
+    for(uint32_t streamIdx=0; streamIdx<m_streamCount; streamIdx++)
+    {
+        GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[streamIdx]) );
+        GL_CHECK( glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_texture, 0, streamIdx) );
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Error: gain compensation framebuffer is incomplete." << std::endl;
+            std::abort();
+        }
+    }
+    GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, framebuffer) );
+
+    GL_CHECK( glGenBuffers(1, &m_pbo) );
+    GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbo) );
+    GL_CHECK( glBufferData(GL_PIXEL_PACK_BUFFER, m_streamCount * m_width * m_height * 4, nullptr, GL_STREAM_READ) );
+    GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
+}
+
+inastitch::opengl::GainCompensator::~GainCompensator()
+{
+    if(m_fence != nullptr)
+    {
+        GL_CHECK( glDeleteSync(static_cast<GLsync>(m_fence)) );
+    }
+    GL_CHECK( glDeleteBuffers(1, &m_pbo) );
+    GL_CHECK( glDeleteFramebuffers(m_streamCount, m_framebuffers.data()) );
+    GL_CHECK( glDeleteTextures(1, &m_texture) );
+}
+
+void inastitch::opengl::GainCompensator::update(const WarpMesh &warpMesh)
+{
+    if(m_fence != nullptr)
+    {
+        // Note: never waits, statistics are used whenever they are ready
+        const auto fence = static_cast<GLsync>(m_fence);
+        GLenum waitResult;
+        GL_CHECK( waitResult = glClientWaitSync(fence, 0, 0) );
+        if(waitResult == GL_TIMEOUT_EXPIRED)
+        {
+            return;
+        }
+        if(waitResult == GL_WAIT_FAILED) {
+            std::cerr << "Error: failed to wait for gain compensation fence" << std::endl;
+            std::abort();
+        }
+        GL_CHECK( glDeleteSync(fence) );
+        m_fence = nullptr;
+
+        const auto bufferSize = m_streamCount * m_width * m_height * 4;
+        GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbo) );
+        const void* pixels = nullptr;
+        GL_CHECK( pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bufferSize, GL_MAP_READ_BIT) );
+        if(pixels == nullptr) {
+            std::cerr << "Error: failed to map gain compensation buffer" << std::endl;
+            std::abort();
+        }
+        solve(static_cast<const uint8_t*>(pixels));
+        GL_CHECK( glUnmapBuffer(GL_PIXEL_PACK_BUFFER) );
+        GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
+        return;
+    }
+
+    if((m_frameCount++ % m_frameInterval) != 0)
+    {
+        return;
+    }
+
+    GLint framebuffer;
+    GLint viewport[4];
+    GLfloat clearColor[4];
+    GL_CHECK( glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer) );
+    GL_CHECK( glGetIntegerv(GL_VIEWPORT, viewport) );
+    GL_CHECK( glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor) );
+
+    // Note: alpha is cleared, so that it tells which pixels the stream covers
+    GL_CHECK( glViewport(0, 0, m_width, m_height) );
+    GL_CHECK( glClearColor(0.0f, 0.0f, 0.0f, 0.0f) );
+    for(uint32_t streamIdx=0; streamIdx<m_streamCount; streamIdx++)
+    {
+        GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[streamIdx]) );
+        GL_CHECK( glClear(GL_COLOR_BUFFER_BIT) );
+        warpMesh.draw(streamIdx);
+    }
+
+    GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbo) );
+    for(uint32_t streamIdx=0; streamIdx<m_streamCount; streamIdx++)
+    {
+        GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffers[streamIdx]) );
+        const uintptr_t offset = streamIdx * m_width * m_height * 4;
+        GL_CHECK( glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<void*>(offset)) );
+    }
+    GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
+    GL_CHECK( m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) );
+    GL_CHECK( glFlush() );
+    m_renderGains = m_gains;
+
+    GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, framebuffer) );
+    GL_CHECK( glViewport(viewport[0], viewport[1], viewport[2], viewport[3]) );
+    GL_CHECK( glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]) );
+}
+
+void inastitch::opengl::GainCompensator::solve(const uint8_t* pixels)
+{
+    const uint32_t channelCount = 3;
+    const uint32_t layerSize = m_width * m_height * 4;
+
+    // sum of the colors of stream i where it overlaps stream j, at [i * streamCount + j]
+    std::vector<uint32_t> overlapCounts(m_streamCount * m_streamCount, 0);
+    std::vector<std::array<uint64_t, channelCount>> overlapSums(m_streamCount * m_streamCount, { 0, 0, 0 });
+
+    std::vector<uint32_t> coveringStreams;
+    coveringStreams.reserve(m_streamCount);
+    for(uint32_t pixelIdx=0; pixelIdx<m_width*m_height; pixelIdx++)
+    {
+        coveringStreams.clear();
+        for(uint32_t streamIdx=0; streamIdx<m_streamCount; streamIdx++)
+        {
+            const uint8_t* const pixel = pixels + streamIdx * layerSize + pixelIdx * 4;
+            if( (pixel[3] >= minCoveredAlpha) &&
+                (pixel[0] <= maxUnsaturatedValue) && (pixel[1] <= maxUnsaturatedValue) && (pixel[2] <= maxUnsaturatedValue) )
+            {
+                coveringStreams.push_back(streamIdx);
+            }
+        }
+
+        for(const auto i : coveringStreams)
+        {
+            const uint8_t* const pixel = pixels + i * layerSize + pixelIdx * 4;
+            for(const auto j : coveringStreams)
+            {
+                if(i == j)
+                {
+                    continue;
+                }
+                overlapCounts[i * m_streamCount + j]++;
+                auto &sums = overlapSums[i * m_streamCount + j];
+                for(uint32_t channelIdx=0; channelIdx<channelCount; channelIdx++)
+                {
+                    sums[channelIdx] += pixel[channelIdx];
+                }
+            }
+        }
+    }
+
+    // Note: each channel is solved on its own, from the colors before compensation
+    for(uint32_t channelIdx=0; channelIdx<channelCount; channelIdx++)
+    {
+        auto meanColor = [&](uint32_t i, uint32_t j)
+        {
+            const auto overlapIdx = i * m_streamCount + j;
+            return overlapSums[overlapIdx][channelIdx] / (255.0f * overlapCounts[overlapIdx] * m_renderGains[i][channelIdx]);
+        };
+
+        // normal equations of the gain error, A * gains = b
+        const uint32_t n = m_streamCount;
+        std::vector<float> a(n * n, 0.0f), b(n, 0.0f);
+        for(uint32_t i=0; i<n; i++)
+        {
+            for(uint32_t j=0; j<n; j++)
+            {
+                const auto overlapCount = overlapCounts[i * n + j];
+                if( (i == j) || (overlapCount < minOverlapPixelCount) )
+                {
+                    continue;
+                }
+                const float colorIJ = meanColor(i, j);
+                const float colorJI = meanColor(j, i);
+                a[i * n + i] += overlapCount * (2.0f * colorIJ * colorIJ / (noiseSigma * noiseSigma) + 1.0f / (gainSigma * gainSigma));
+                a[i * n + j] -= overlapCount * 2.0f * colorIJ * colorJI / (noiseSigma * noiseSigma);
+                b[i] += overlapCount / (gainSigma * gainSigma);
+            }
+
+            // a stream that overlaps no other keeps a unit gain
+            if(a[i * n + i] == 0.0f)
+            {
+                a[i * n + i] = 1.0f;
+                b[i] = 1.0f;
+            }
+        }
+
+        std::vector<float> solvedGains;
+        if(!solveLinearSystem(a, b, n, solvedGains))
+        {
+            // Note: gains are kept as is
+            continue;
+        }
+
+        for(uint32_t streamIdx=0; streamIdx<n; streamIdx++)
+        {
+            const float targetGain = std::min(std::max(solvedGains[streamIdx], minGain), maxGain);
+            auto &gain = m_gains[streamIdx][channelIdx];
+            gain += smoothingFactor * (targetGain - gain);
+        }
+    }
+}
@@ -0,0 +1,150 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/opengl/include/HeadlessContext.hpp"
+#include "inastitch/opengl/include/OpenGlHelper.hpp"
+
+// EGL includes:
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// Glfw includes:
+// Use OpenGL ES 3.x
+#define GLFW_INCLUDE_ES3
+#include <GLFW/glfw3.h>
+
+// Std includes:
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+bool hasExtension(const char* extensions, const char* extension)
+{
+    // Note: extension names are separated by spaces
+    const auto extensionSize = strlen(extension);
+    for(const char* ext = extensions; ext && (ext = strstr(ext, extension)); ext += extensionSize)
+    {
+        if( ((ext == extensions) || (ext[-1] == ' ')) &&
+            ((ext[extensionSize] == ' ') || (ext[extensionSize] == '\0')) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+inastitch::opengl::HeadlessContext::HeadlessContext(uint32_t width, uint32_t height)
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+
+    // Note: surfaceless platform needs neither X11 nor Wayland nor DRM device
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    const auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if(getPlatformDisplay && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+    {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if(display == EGL_NO_DISPLAY)
+    {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLint majorVersion, minorVersion;
+    if( (display == EGL_NO_DISPLAY) || !eglInitialize(display, &majorVersion, &minorVersion) )
+    {
+        std::cerr << "Error: cannot initialize EGL display." << std::endl;
+        std::abort();
+    }
+    eglBindAPI(EGL_OPENGL_ES_API);
+
+    // Note: without surfaceless context, a (tiny) pbuffer is still needed to make the context current
+    const bool isSurfaceless = hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, isSurfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if(!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || (configCount == 0))
+    {
+        std::cerr << "Error: no EGL config for OpenGL ES 3." << std::endl;
+        std::abort();
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 3,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if(context == EGL_NO_CONTEXT)
+    {
+        std::cerr << "Error: cannot create EGL context." << std::endl;
+        std::abort();
+    }
+
+    EGLSurface surface = EGL_NO_SURFACE;
+    if(!isSurfaceless)
+    {
+        const EGLint pbufferAttribs[] = {
+            EGL_WIDTH, 1,
+            EGL_HEIGHT, 1,
+            EGL_NONE
+        };
+        surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+    }
+
+    if(!eglMakeCurrent(display, surface, surface, context))
+    {
+        std::cerr << "Error: cannot make EGL context current." << std::endl;
+        std::abort();
+    }
+
+    m_display = display;
+    m_surface = surface;
+    m_context = context;
+
+    // Note: same buffers as the default framebuffer of a window
+    GL_CHECK( glGenRenderbuffers(1, &m_colorRenderbuffer) );
+    GL_CHECK( glBindRenderbuffer(GL_RENDERBUFFER, m_colorRenderbuffer) );
+    GL_CHECK( glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height) );
+    GL_CHECK( glGenRenderbuffers(1, &m_depthRenderbuffer) );
+    GL_CHECK( glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderbuffer) );
+    GL_CHECK( glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height) );
+    GL_CHECK( glBindRenderbuffer(GL_RENDERBUFFER, 0) );
+
+    GL_CHECK( glGenFramebuffers(1, &m_framebuffer) );
+    GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer) );
+    GL_CHECK( glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorRenderbuffer) );
+    GL_CHECK( glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderbuffer) );
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Error: headless framebuffer is incomplete." << std::endl;
+        std::abort();
+    }
+}
+
+inastitch::opengl::HeadlessContext::~HeadlessContext()
+{
+    GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, 0) );
+    GL_CHECK( glDeleteFramebuffers(1, &m_framebuffer) );
+    GL_CHECK( glDeleteRenderbuffers(1, &m_depthRenderbuffer) );
+    GL_CHECK( glDeleteRenderbuffers(1, &m_colorRenderbuffer) );
+
+    eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if(m_surface != EGL_NO_SURFACE)
+    {
+        eglDestroySurface(m_display, m_surface);
+    }
+    eglDestroyContext(m_display, m_context);
+    eglTerminate(m_display);
+}
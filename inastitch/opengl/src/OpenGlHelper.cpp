@@ -15,6 +15,10 @@
 
 // Std includes:
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
 
 using namespace inastitch::opengl::helper;
 
@@ -81,58 +85,103 @@ int inastitch::opengl::helper::getShaderProgram(const char *vertexShaderSource,
     return shaderProgram;
 }
 
-inastitch::opengl::helper::Overlay::Overlay(uint32_t width, uint32_t height)
-    : m_width( width )
-    , m_height( height )
-    , m_rgbaBuffer( new uint8_t[m_width * m_height * 4] )
-{ }
-
-inastitch::opengl::helper::Overlay::~Overlay()
-{
-    delete[] m_rgbaBuffer;
-}
-
-void inastitch::opengl::helper::Overlay::clear()
+inastitch::opengl::helper::TextureFootprint inastitch::opengl::helper::getTextureFootprint(
+    uint32_t gridWidth, uint32_t gridHeight,
+    const glm::vec4 *clipPositions, const glm::vec2 *texCoords,
+    uint32_t textureWidth, uint32_t textureHeight,
+    uint32_t outWidth, uint32_t outHeight)
 {
-    for(uint32_t r=0; r<m_height; r++) {
-        for(uint32_t c=0; c<m_width; c++) {
-            m_rgbaBuffer[(r*m_width + c)*4    ] = 0xFF; // R
-            m_rgbaBuffer[(r*m_width + c)*4 + 1] = 0xFF; // G
-            m_rgbaBuffer[(r*m_width + c)*4 + 2] = 0xFF; // B
-            m_rgbaBuffer[(r*m_width + c)*4 + 3] = 0x00; // A
+    // The quad is sampled on a grid (e.g., the vertices of its mesh), rather than solving the projection analytically,
+    // so that any warp, lens distortion or output projection (and clipping by the output viewport) is supported.
+    const uint32_t pointCount = (gridWidth + 1) * (gridHeight + 1);
+    auto pointIdx = [gridWidth](uint32_t row, uint32_t col) { return row * (gridWidth + 1) + col; };
+
+    TextureFootprint footprint;
+    footprint.screenMin = glm::vec2(std::numeric_limits<float>::max());
+    footprint.screenMax = glm::vec2(std::numeric_limits<float>::lowest());
+    footprint.texMin = glm::vec2(std::numeric_limits<float>::max());
+    footprint.texMax = glm::vec2(std::numeric_limits<float>::lowest());
+
+    std::vector<glm::vec2> screenPos(pointCount);
+    std::vector<uint8_t> isInside(pointCount, false);
+    std::vector<uint8_t> isBehind(pointCount, false);
+
+    for(uint32_t idx=0; idx<pointCount; idx++)
+    {
+        const auto &clipPos = clipPositions[idx];
+        isBehind[idx] = (clipPos.w <= 0.0f);
+        if(isBehind[idx]) {
+            continue;
         }
-    }
-};
-
-void inastitch::opengl::helper::Overlay::putChar(uint32_t xOffset, uint32_t yOffset, uint8_t asciiCode)
-{
-    for(uint32_t r=0; r<5; r++) {
-        for(uint32_t c=0; c<5; c++) {
-            m_rgbaBuffer[((r+yOffset)*m_width + (c+xOffset))*4 + 3] = digitBits.at(asciiCode).at(r*5+c);
+        // normalized device coordinates to output pixels
+        screenPos[idx] = glm::vec2(
+            (clipPos.x / clipPos.w + 1.0f) * 0.5f * outWidth,
+            (clipPos.y / clipPos.w + 1.0f) * 0.5f * outHeight);
+
+        isInside[idx] = (screenPos[idx].x >= 0.0f) && (screenPos[idx].x <= outWidth)
+                     && (screenPos[idx].y >= 0.0f) && (screenPos[idx].y <= outHeight);
+        if(isInside[idx])
+        {
+            footprint.isVisible = true;
+            footprint.screenMin = glm::min(footprint.screenMin, screenPos[idx]);
+            footprint.screenMax = glm::max(footprint.screenMax, screenPos[idx]);
         }
     }
-};
 
-void inastitch::opengl::helper::Overlay::putDigit(uint32_t xOffset, uint32_t yOffset, uint8_t digit)
-{
-    putChar(xOffset, yOffset, digit+48);
-};
-
-void inastitch::opengl::helper::Overlay::putNumber(uint32_t xOffset, uint32_t yOffset, uint32_t number, uint8_t digitCount)
-{
-    for(uint32_t p=0; p<digitCount; p++)
+    // The viewport border crosses grid cells, so texture coordinates of the grid points
+    // next to a visible one are also included.
+    for(uint32_t row=0; row<=gridHeight; row++)
     {
-        const auto n = number % 10;
-        putDigit(xOffset + (digitCount*(5+1) - p*(5+1)), yOffset, n);
-        number /= 10;
+        for(uint32_t col=0; col<=gridWidth; col++)
+        {
+            bool isNextToInside = false;
+            for(uint32_t r=(row > 0 ? row-1 : 0); r<=std::min(row+1, gridHeight); r++)
+            {
+                for(uint32_t c=(col > 0 ? col-1 : 0); c<=std::min(col+1, gridWidth); c++)
+                {
+                    isNextToInside = isNextToInside || isInside[pointIdx(r, c)];
+                }
+            }
+
+            // Note: points behind the camera have no texture coordinates
+            const auto idx = pointIdx(row, col);
+            if(isNextToInside && !isBehind[idx])
+            {
+                footprint.texMin = glm::min(footprint.texMin, texCoords[idx]);
+                footprint.texMax = glm::max(footprint.texMax, texCoords[idx]);
+            }
+        }
     }
-};
 
-void inastitch::opengl::helper::Overlay::putString(uint32_t xOffset, uint32_t yOffset, const char * const string, uint8_t charCount)
-{
-    for(uint32_t p=0; p<charCount; p++)
+    // output pixels per texture pixel, along both grid directions
+    for(uint32_t row=0; row<=gridHeight; row++)
     {
-        const auto c = string[p];
-        putChar(xOffset + p*(5+1), yOffset, c);
+        for(uint32_t col=0; col<=gridWidth; col++)
+        {
+            const auto idx = pointIdx(row, col);
+            if(isBehind[idx]) continue;
+
+            // Note: a grid cell counts as soon as one of its ends is visible
+            auto updateRatio = [&](uint32_t nextIdx)
+            {
+                if(isBehind[nextIdx]) return;
+                if(!isInside[idx] && !isInside[nextIdx]) return;
+
+                const auto screenDiff = screenPos[nextIdx] - screenPos[idx];
+                auto texDiff = texCoords[nextIdx] - texCoords[idx];
+                texDiff.x *= textureWidth;
+                texDiff.y *= textureHeight;
+
+                const auto texelDist = glm::length(texDiff);
+                if(texelDist > 0.0f)
+                {
+                    footprint.maxPixelPerTexel = std::max(footprint.maxPixelPerTexel, glm::length(screenDiff) / texelDist);
+                }
+            };
+            if(col < gridWidth) updateRatio(pointIdx(row, col+1));
+            if(row < gridHeight) updateRatio(pointIdx(row+1, col));
+        }
     }
-};
+
+    return footprint;
+}
@@ -4,9 +4,9 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 // Local includes:
-#include "inastitch/opengl/include/OpenGlHelper.hpp"
+#include "inastitch/opengl/include/TextOverlay.hpp"
 
-const std::vector<std::array<uint8_t, 25>> inastitch::opengl::helper::Overlay::digitBits =
+const std::vector<std::array<uint8_t, 25>> inastitch::opengl::TextOverlay::glyphBits =
 {
     { // [0]
       0x00, 0x00, 0x00, 0x00, 0x00,
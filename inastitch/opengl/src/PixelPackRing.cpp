@@ -0,0 +1,175 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/opengl/include/PixelPackRing.hpp"
+#include "inastitch/opengl/include/OpenGlHelper.hpp"
+
+// Glfw includes:
+// Use OpenGL ES 3.x
+#define GLFW_INCLUDE_ES3
+#include <GLFW/glfw3.h>
+
+// Std includes:
+#include <iostream>
+
+inastitch::opengl::PixelPackRing::PixelPackRing(uint32_t bufferCount, uint32_t bufferSize)
+    : m_bufferSize(bufferSize)
+    , m_slots(bufferCount)
+{
+    for(uint32_t slotIdx=0; slotIdx<m_slots.size(); slotIdx++)
+    {
+        auto &slot = m_slots[slotIdx];
+        GL_CHECK( glGenBuffers(1, &slot.pbo) );
+        GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo) );
+        GL_CHECK( glBufferData(GL_PIXEL_PACK_BUFFER, m_bufferSize, nullptr, GL_STREAM_READ) );
+        m_freeSlotIdxs.push_back(slotIdx);
+    }
+    GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
+}
+
+inastitch::opengl::PixelPackRing::~PixelPackRing()
+{
+    recycle();
+
+    for(auto &slot : m_slots)
+    {
+        if(slot.fence != nullptr) {
+            GL_CHECK( glDeleteSync(static_cast<GLsync>(slot.fence)) );
+        }
+        GL_CHECK( glDeleteBuffers(1, &slot.pbo) );
+    }
+}
+
+bool inastitch::opengl::PixelPackRing::bind(bool isBlocking)
+{
+    recycle();
+
+    // Note: pending buffers are only freed by mapping them, so waiting for those would never end
+    if(m_freeSlotIdxs.empty() && isBlocking && (m_mappedCount > 0))
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_releaseCondition.wait(lock, [this]{ return !m_releasedSlotIdxs.empty(); });
+        }
+        recycle();
+    }
+
+    if(m_freeSlotIdxs.empty())
+    {
+        m_droppedCount++;
+        return false;
+    }
+
+    m_boundSlotIdx = m_freeSlotIdxs.back();
+    m_freeSlotIdxs.pop_back();
+    GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, m_slots[m_boundSlotIdx].pbo) );
+    return true;
+}
+
+void inastitch::opengl::PixelPackRing::unbind()
+{
+    if(m_boundSlotIdx < 0)
+    {
+        return;
+    }
+
+    GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
+
+    auto &slot = m_slots[m_boundSlotIdx];
+    GL_CHECK( slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) );
+    // Note: fence is only checked by 'map', commands must reach the GPU meanwhile
+    GL_CHECK( glFlush() );
+    m_pendingSlotIdxs.push_back(m_boundSlotIdx);
+    m_boundSlotIdx = -1;
+}
+
+std::shared_ptr<inastitch::jpeg::Frame> inastitch::opengl::PixelPackRing::map(bool isWaiting)
+{
+    if(m_pendingSlotIdxs.empty())
+    {
+        return nullptr;
+    }
+
+    const uint32_t slotIdx = m_pendingSlotIdxs.front();
+    auto &slot = m_slots[slotIdx];
+
+    // wait for the read back into this buffer to complete
+    {
+        const auto fence = static_cast<GLsync>(slot.fence);
+        const GLuint64 timeoutNs = isWaiting ? 1000000000 : 0;
+        GLenum waitResult;
+        do {
+            GL_CHECK( waitResult = glClientWaitSync(fence, 0, timeoutNs) );
+        } while(isWaiting && (waitResult == GL_TIMEOUT_EXPIRED));
+
+        if(waitResult == GL_TIMEOUT_EXPIRED) {
+            return nullptr;
+        }
+
+        if(waitResult == GL_WAIT_FAILED) {
+            std::cerr << "Error: failed to wait for pixel pack buffer fence" << std::endl;
+            std::abort();
+        }
+
+        GL_CHECK( glDeleteSync(fence) );
+        slot.fence = nullptr;
+    }
+
+    GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo) );
+    uint8_t* buffer = nullptr;
+    GL_CHECK( buffer = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, m_bufferSize, GL_MAP_READ_BIT)) );
+    GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
+
+    if(buffer == nullptr) {
+        std::cerr << "Error: failed to map pixel pack buffer" << std::endl;
+        std::abort();
+    }
+
+    slot.frame.emplace(buffer, m_bufferSize);
+    m_pendingSlotIdxs.pop_front();
+    m_mappedCount++;
+
+    // Note: slots are owned by the ring, released frames are unmapped by the OpenGL thread
+    return std::shared_ptr<jpeg::Frame>(&*slot.frame, [this, slotIdx](jpeg::Frame*){ release(slotIdx); });
+}
+
+bool inastitch::opengl::PixelPackRing::hasFreeBuffer()
+{
+    recycle();
+    return !m_freeSlotIdxs.empty();
+}
+
+void inastitch::opengl::PixelPackRing::release(uint32_t slotIdx)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_releasedSlotIdxs.push_back(slotIdx);
+    }
+    m_releaseCondition.notify_one();
+}
+
+void inastitch::opengl::PixelPackRing::recycle()
+{
+    std::vector<uint32_t> releasedSlotIdxs;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        releasedSlotIdxs.swap(m_releasedSlotIdxs);
+    }
+
+    for(const auto slotIdx : releasedSlotIdxs)
+    {
+        auto &slot = m_slots[slotIdx];
+        GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo) );
+        GL_CHECK( glUnmapBuffer(GL_PIXEL_PACK_BUFFER) );
+        slot.frame.reset();
+        m_freeSlotIdxs.push_back(slotIdx);
+        m_mappedCount--;
+    }
+    if(!releasedSlotIdxs.empty())
+    {
+        GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
+    }
+}
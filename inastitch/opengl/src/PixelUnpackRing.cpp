@@ -0,0 +1,133 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/opengl/include/PixelUnpackRing.hpp"
+#include "inastitch/opengl/include/OpenGlHelper.hpp"
+
+// Glfw includes:
+// Use OpenGL ES 3.x
+#define GLFW_INCLUDE_ES3
+#include <GLFW/glfw3.h>
+
+// Std includes:
+#include <iostream>
+
+inastitch::opengl::PixelUnpackRing::PixelUnpackRing(uint32_t bufferCount, uint32_t bufferSize)
+    : m_bufferSize(bufferSize)
+    , m_slots(bufferCount)
+{
+    for(auto &slot : m_slots)
+    {
+        GL_CHECK( glGenBuffers(1, &slot.pbo) );
+        GL_CHECK( glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo) );
+        GL_CHECK( glBufferData(GL_PIXEL_UNPACK_BUFFER, m_bufferSize, nullptr, GL_STREAM_DRAW) );
+    }
+    GL_CHECK( glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0) );
+}
+
+inastitch::opengl::PixelUnpackRing::~PixelUnpackRing()
+{
+    if(m_mappedSlotIdx >= 0)
+    {
+        GL_CHECK( glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_slots[m_mappedSlotIdx].pbo) );
+        GL_CHECK( glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) );
+        GL_CHECK( glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0) );
+    }
+
+    for(auto &slot : m_slots)
+    {
+        if(slot.fence != nullptr) {
+            GL_CHECK( glDeleteSync(static_cast<GLsync>(slot.fence)) );
+        }
+        GL_CHECK( glDeleteBuffers(1, &slot.pbo) );
+    }
+}
+
+std::shared_ptr<inastitch::jpeg::Frame> inastitch::opengl::PixelUnpackRing::map()
+{
+    if(m_mappedSlotIdx < 0)
+    {
+        // Note: a buffer whose frame is still referenced is skipped
+        uint32_t skippedSlotCount = 0;
+        while(m_slots[m_nextSlotIdx].frame && (m_slots[m_nextSlotIdx].frame.use_count() > 1))
+        {
+            if(++skippedSlotCount == m_slots.size())
+            {
+                return nullptr;
+            }
+            m_nextSlotIdx = (m_nextSlotIdx + 1) % m_slots.size();
+        }
+
+        auto &slot = m_slots[m_nextSlotIdx];
+
+        // wait for the texture update reading this buffer to complete
+        if(slot.fence != nullptr)
+        {
+            const auto fence = static_cast<GLsync>(slot.fence);
+            const GLuint64 timeoutNs = 1000000000;
+            GLenum waitResult;
+            do {
+                GL_CHECK( waitResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeoutNs) );
+            } while(waitResult == GL_TIMEOUT_EXPIRED);
+
+            if(waitResult == GL_WAIT_FAILED) {
+                std::cerr << "Error: failed to wait for pixel unpack buffer fence" << std::endl;
+                std::abort();
+            }
+
+            GL_CHECK( glDeleteSync(fence) );
+            slot.fence = nullptr;
+        }
+
+        // Note: buffer is known to be idle, no need for the driver to synchronize
+        GL_CHECK( glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo) );
+        uint8_t* buffer = nullptr;
+        GL_CHECK( buffer = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_bufferSize,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT)) );
+        GL_CHECK( glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0) );
+
+        if(buffer == nullptr) {
+            std::cerr << "Error: failed to map pixel unpack buffer" << std::endl;
+            std::abort();
+        }
+
+        slot.frame = std::make_shared<jpeg::Frame>(buffer, m_bufferSize);
+        m_mappedSlotIdx = m_nextSlotIdx;
+        m_nextSlotIdx = (m_nextSlotIdx + 1) % m_slots.size();
+    }
+
+    return m_slots[m_mappedSlotIdx].frame;
+}
+
+bool inastitch::opengl::PixelUnpackRing::bind(const jpeg::Frame &frame)
+{
+    if( (m_mappedSlotIdx < 0) || (&frame != m_slots[m_mappedSlotIdx].frame.get()) )
+    {
+        return false;
+    }
+
+    // Note: OpenGL ES cannot use a buffer while it is mapped
+    GL_CHECK( glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_slots[m_mappedSlotIdx].pbo) );
+    GL_CHECK( glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) );
+
+    m_boundSlotIdx = m_mappedSlotIdx;
+    m_mappedSlotIdx = -1;
+    return true;
+}
+
+void inastitch::opengl::PixelUnpackRing::unbind()
+{
+    if(m_boundSlotIdx < 0)
+    {
+        return;
+    }
+
+    GL_CHECK( glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0) );
+
+    auto &slot = m_slots[m_boundSlotIdx];
+    GL_CHECK( slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) );
+    m_boundSlotIdx = -1;
+}
@@ -0,0 +1,140 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/opengl/include/RenditionTarget.hpp"
+#include "inastitch/opengl/include/OpenGlHelper.hpp"
+
+// Glfw includes:
+// Use OpenGL ES 3.x
+#define GLFW_INCLUDE_ES3
+#include <GLFW/glfw3.h>
+
+// Std includes:
+#include <cstring>
+#include <iostream>
+
+inastitch::opengl::RenditionTarget::RenditionTarget(uint32_t width, uint32_t height, bool isYuv, bool isDepthEnabled)
+    : m_width(width)
+    , m_height(height)
+{
+    GL_CHECK( glGenRenderbuffers(1, &m_renderbuffer) );
+    GL_CHECK( glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffer) );
+    GL_CHECK( glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_width, m_height) );
+    if(isDepthEnabled)
+    {
+        GL_CHECK( glGenRenderbuffers(1, &m_depthRenderbuffer) );
+        GL_CHECK( glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderbuffer) );
+        GL_CHECK( glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_width, m_height) );
+    }
+    GL_CHECK( glBindRenderbuffer(GL_RENDERBUFFER, 0) );
+
+    GLint framebuffer;
+    GL_CHECK( glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer) );
+    GL_CHECK( glGenFramebuffers(1, &m_framebuffer) );
+    GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer) );
+    GL_CHECK( glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_renderbuffer) );
+    if(m_depthRenderbuffer != 0)
+    {
+        GL_CHECK( glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderbuffer) );
+    }
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Error: rendition " << m_width << "x" << m_height << " framebuffer is incomplete." << std::endl;
+        std::abort();
+    }
+    GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, framebuffer) );
+
+    if(isYuv)
+    {
+        m_yuvPacker = std::make_unique<YuvPacker>(m_width, m_height);
+    }
+
+    GL_CHECK( glGenBuffers(pboCount, m_pboIds) );
+    for(uint32_t i=0; i<pboCount; i++)
+    {
+        GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pboIds[i]) );
+        GL_CHECK( glBufferData(GL_PIXEL_PACK_BUFFER, bufferSize(), nullptr, GL_STREAM_READ) );
+    }
+    GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
+}
+
+inastitch::opengl::RenditionTarget::~RenditionTarget()
+{
+    GL_CHECK( glDeleteBuffers(pboCount, m_pboIds) );
+    GL_CHECK( glDeleteFramebuffers(1, &m_framebuffer) );
+    GL_CHECK( glDeleteRenderbuffers(1, &m_renderbuffer) );
+    if(m_depthRenderbuffer != 0)
+    {
+        GL_CHECK( glDeleteRenderbuffers(1, &m_depthRenderbuffer) );
+    }
+}
+
+void inastitch::opengl::RenditionTarget::blitFrom(uint32_t srcFramebuffer, uint32_t srcWidth, uint32_t srcHeight)
+{
+    GLint readFramebuffer, drawFramebuffer;
+    GL_CHECK( glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer) );
+    GL_CHECK( glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer) );
+
+    GL_CHECK( glBindFramebuffer(GL_READ_FRAMEBUFFER, srcFramebuffer) );
+    GL_CHECK( glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer) );
+    GL_CHECK( glBlitFramebuffer(0, 0, srcWidth, srcHeight, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_LINEAR) );
+
+    GL_CHECK( glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer) );
+    GL_CHECK( glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer) );
+}
+
+void inastitch::opengl::RenditionTarget::readPixels()
+{
+    if(m_pendingCount == pboCount) {
+        std::cerr << "Error: rendition " << m_width << "x" << m_height << " has no free PBO" << std::endl;
+        std::abort();
+    }
+
+    GLint framebuffer;
+    GL_CHECK( glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer) );
+    GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer) );
+
+    const auto readPboIdx = (m_copyPboIdx + m_pendingCount) % pboCount;
+    GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pboIds[readPboIdx]) );
+    if(m_yuvPacker)
+    {
+        m_yuvPacker->pack();
+        m_yuvPacker->readPixels(nullptr);
+    }
+    else
+    {
+        GL_CHECK( glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr) );
+    }
+    GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
+    m_pendingCount++;
+
+    GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, framebuffer) );
+}
+
+bool inastitch::opengl::RenditionTarget::copyPixels(uint8_t* buffer)
+{
+    if(m_pendingCount == 0)
+    {
+        return false;
+    }
+
+    if(buffer)
+    {
+        GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pboIds[m_copyPboIdx]) );
+        const void* ptr = nullptr;
+        GL_CHECK( ptr = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bufferSize(), GL_MAP_READ_BIT) );
+        if(ptr == nullptr) {
+            std::cerr << "Error: failed to map rendition " << m_width << "x" << m_height << " PBO" << std::endl;
+            std::abort();
+        }
+        memcpy(buffer, ptr, bufferSize());
+        GL_CHECK( glUnmapBuffer(GL_PIXEL_PACK_BUFFER) );
+        GL_CHECK( glBindBuffer(GL_PIXEL_PACK_BUFFER, 0) );
+    }
+
+    m_copyPboIdx = (m_copyPboIdx + 1) % pboCount;
+    m_pendingCount--;
+    return true;
+}
@@ -0,0 +1,230 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/opengl/include/TextOverlay.hpp"
+#include "inastitch/opengl/include/OpenGlHelper.hpp"
+
+// Glfw includes:
+// Use OpenGL ES 3.x
+#define GLFW_INCLUDE_ES3
+#include <GLFW/glfw3.h>
+
+// Std includes:
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+// Note: one quad per glyph instance, corners are indexed by 'gl_VertexID'
+static const GLchar* glyphVertexShaderSource = R""""(#version 300 es
+precision highp float;
+
+layout(location = 0) in vec2 glyphPos;
+layout(location = 1) in float asciiCode;
+
+uniform vec2 canvasSize;
+uniform vec2 atlasSize;
+uniform float glyphSize;
+uniform float atlasColumnCount;
+
+out vec2 atlasCoord;
+
+const vec2 corners[6] = vec2[6](vec2(0.0, 0.0), vec2(0.0, 1.0), vec2(1.0, 1.0),
+                                vec2(1.0, 1.0), vec2(1.0, 0.0), vec2(0.0, 0.0));
+
+void main() {
+   vec2 corner = corners[gl_VertexID];
+   // Note: canvas rows are top-down
+   vec2 canvasPos = (glyphPos + corner * glyphSize) / canvasSize;
+   gl_Position = vec4(canvasPos.x * 2.0 - 1.0, 1.0 - canvasPos.y * 2.0, 0.0, 1.0);
+
+   vec2 atlasCell = vec2(mod(asciiCode, atlasColumnCount), floor(asciiCode / atlasColumnCount));
+   atlasCoord = (atlasCell + corner) * glyphSize / atlasSize;
+}
+)"""";
+
+static const GLchar* glyphFragmentShaderSource = R""""(#version 300 es
+precision mediump float;
+
+in vec2 atlasCoord;
+uniform sampler2D atlas;
+
+out vec4 fragColor;
+
+void main() {
+   fragColor = vec4(1.0, 1.0, 1.0, texture(atlas, atlasCoord).r);
+}
+)"""";
+
+static const uint32_t atlasColumnCount = 16;
+
+inastitch::opengl::TextOverlay::TextOverlay(uint32_t width, uint32_t height)
+    : m_width(width)
+    , m_height(height)
+{
+    // glyph atlas, one 5x5 cell per ASCII code
+    const uint32_t atlasRowCount = (glyphBits.size() + atlasColumnCount - 1) / atlasColumnCount;
+    const uint32_t atlasWidth = atlasColumnCount * glyphSize;
+    const uint32_t atlasHeight = atlasRowCount * glyphSize;
+    std::vector<uint8_t> atlasPixels(atlasWidth * atlasHeight, 0x00);
+    for(uint32_t asciiCode=0; asciiCode<glyphBits.size(); asciiCode++)
+    {
+        const uint32_t cellX = (asciiCode % atlasColumnCount) * glyphSize;
+        const uint32_t cellY = (asciiCode / atlasColumnCount) * glyphSize;
+        for(uint32_t r=0; r<glyphSize; r++) {
+            for(uint32_t c=0; c<glyphSize; c++) {
+                atlasPixels[(cellY + r) * atlasWidth + cellX + c] = glyphBits[asciiCode][r*glyphSize+c];
+            }
+        }
+    }
+
+    GLint unpackAlignment;
+    GL_CHECK( glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment) );
+    GL_CHECK( glPixelStorei(GL_UNPACK_ALIGNMENT, 1) );
+    GL_CHECK( glGenTextures(1, &m_atlasTexture) );
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D, m_atlasTexture) );
+    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE) );
+    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE) );
+    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST) );
+    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST) );
+    GL_CHECK( glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, atlasPixels.data()) );
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D, 0) );
+    GL_CHECK( glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment) );
+
+    m_shaderProgram = helper::getShaderProgram(glyphVertexShaderSource, glyphFragmentShaderSource);
+    GL_CHECK( glUseProgram(m_shaderProgram) );
+    GL_CHECK( glUniform1i(glGetUniformLocation(m_shaderProgram, "atlas"), 0) );
+    GL_CHECK( glUniform2f(glGetUniformLocation(m_shaderProgram, "canvasSize"), m_width, m_height) );
+    GL_CHECK( glUniform2f(glGetUniformLocation(m_shaderProgram, "atlasSize"), atlasWidth, atlasHeight) );
+    GL_CHECK( glUniform1f(glGetUniformLocation(m_shaderProgram, "glyphSize"), glyphSize) );
+    GL_CHECK( glUniform1f(glGetUniformLocation(m_shaderProgram, "atlasColumnCount"), atlasColumnCount) );
+    GL_CHECK( glUseProgram(0) );
+
+    // Note: buffer is allocated on first draw, attributes advance once per glyph
+    GL_CHECK( glGenBuffers(1, &m_glyphBuffer) );
+    GL_CHECK( glGenVertexArrays(1, &m_vertexArray) );
+    GL_CHECK( glBindVertexArray(m_vertexArray) );
+    GL_CHECK( glBindBuffer(GL_ARRAY_BUFFER, m_glyphBuffer) );
+    GL_CHECK( glVertexAttribPointer(0, 2, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(Glyph), (GLvoid*)offsetof(Glyph, x)) );
+    GL_CHECK( glEnableVertexAttribArray(0) );
+    GL_CHECK( glVertexAttribDivisor(0, 1) );
+    GL_CHECK( glVertexAttribPointer(1, 1, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(Glyph), (GLvoid*)offsetof(Glyph, asciiCode)) );
+    GL_CHECK( glEnableVertexAttribArray(1) );
+    GL_CHECK( glVertexAttribDivisor(1, 1) );
+    GL_CHECK( glBindVertexArray(0) );
+    GL_CHECK( glBindBuffer(GL_ARRAY_BUFFER, 0) );
+}
+
+inastitch::opengl::TextOverlay::~TextOverlay()
+{
+    GL_CHECK( glDeleteVertexArrays(1, &m_vertexArray) );
+    GL_CHECK( glDeleteBuffers(1, &m_glyphBuffer) );
+    GL_CHECK( glDeleteProgram(m_shaderProgram) );
+    GL_CHECK( glDeleteTextures(1, &m_atlasTexture) );
+}
+
+void inastitch::opengl::TextOverlay::clear()
+{
+    m_glyphs.clear();
+}
+
+void inastitch::opengl::TextOverlay::putChar(uint32_t xOffset, uint32_t yOffset, uint8_t asciiCode)
+{
+    // Note: unknown characters are skipped, like blank ones
+    if(asciiCode >= glyphBits.size())
+    {
+        return;
+    }
+
+    const auto &bits = glyphBits[asciiCode];
+    if(std::all_of(bits.begin(), bits.end(), [](uint8_t bit){ return bit == 0x00; }))
+    {
+        return;
+    }
+
+    m_glyphs.push_back( Glyph{ static_cast<uint16_t>(xOffset), static_cast<uint16_t>(yOffset), asciiCode, 0 } );
+}
+
+void inastitch::opengl::TextOverlay::putDigit(uint32_t xOffset, uint32_t yOffset, uint8_t digit)
+{
+    putChar(xOffset, yOffset, digit+48);
+}
+
+void inastitch::opengl::TextOverlay::putNumber(uint32_t xOffset, uint32_t yOffset, uint32_t number, uint8_t digitCount)
+{
+    for(uint32_t p=0; p<digitCount; p++)
+    {
+        const auto n = number % 10;
+        putDigit(xOffset + (digitCount*(glyphSize+1) - p*(glyphSize+1)), yOffset, n);
+        number /= 10;
+    }
+}
+
+void inastitch::opengl::TextOverlay::putString(uint32_t xOffset, uint32_t yOffset, const char * const string, uint8_t charCount)
+{
+    for(uint32_t p=0; p<charCount; p++)
+    {
+        const auto c = string[p];
+        putChar(xOffset + p*(glyphSize+1), yOffset, c);
+    }
+}
+
+void inastitch::opengl::TextOverlay::draw()
+{
+    if(m_glyphs.empty())
+    {
+        return;
+    }
+
+    GL_CHECK( glBindBuffer(GL_ARRAY_BUFFER, m_glyphBuffer) );
+    if(m_glyphs.size() > m_glyphBufferCapacity)
+    {
+        // Note: buffer only grows, all glyphs are uploaded again
+        m_glyphBufferCapacity = m_glyphs.size();
+        GL_CHECK( glBufferData(GL_ARRAY_BUFFER, m_glyphBufferCapacity * sizeof(Glyph), m_glyphs.data(), GL_DYNAMIC_DRAW) );
+        m_uploadedGlyphs = m_glyphs;
+    }
+    else
+    {
+        // only the glyphs from the first change on are uploaded (e.g., counters at the end of the text)
+        const auto commonCount = std::min(m_glyphs.size(), m_uploadedGlyphs.size());
+        uint32_t firstChangedIdx = 0;
+        while( (firstChangedIdx < commonCount) &&
+               (memcmp(&m_glyphs[firstChangedIdx], &m_uploadedGlyphs[firstChangedIdx], sizeof(Glyph)) == 0) )
+        {
+            firstChangedIdx++;
+        }
+
+        if(firstChangedIdx < m_glyphs.size())
+        {
+            GL_CHECK( glBufferSubData(GL_ARRAY_BUFFER, firstChangedIdx * sizeof(Glyph),
+                                      (m_glyphs.size() - firstChangedIdx) * sizeof(Glyph), &m_glyphs[firstChangedIdx]) );
+        }
+        m_uploadedGlyphs.resize(m_glyphs.size());
+        std::copy(m_glyphs.begin() + firstChangedIdx, m_glyphs.end(), m_uploadedGlyphs.begin() + firstChangedIdx);
+    }
+    GL_CHECK( glBindBuffer(GL_ARRAY_BUFFER, 0) );
+
+    // Note: text is over everything, whatever the depth of the stitched frame
+    GLboolean isDepthTestEnabled;
+    GL_CHECK( isDepthTestEnabled = glIsEnabled(GL_DEPTH_TEST) );
+    GL_CHECK( glDisable(GL_DEPTH_TEST) );
+    GL_CHECK( glEnable(GL_BLEND) );
+    GL_CHECK( glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA) );
+
+    GL_CHECK( glUseProgram(m_shaderProgram) );
+    GL_CHECK( glActiveTexture(GL_TEXTURE0) );
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D, m_atlasTexture) );
+    GL_CHECK( glBindVertexArray(m_vertexArray) );
+    GL_CHECK( glDrawArraysInstanced(GL_TRIANGLES, 0, 6, m_glyphs.size()) );
+    GL_CHECK( glBindVertexArray(0) );
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D, 0) );
+
+    GL_CHECK( glDisable(GL_BLEND) );
+    if(isDepthTestEnabled)
+    {
+        GL_CHECK( glEnable(GL_DEPTH_TEST) );
+    }
+}
@@ -0,0 +1,120 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/opengl/include/TextureRing.hpp"
+#include "inastitch/opengl/include/OpenGlHelper.hpp"
+
+// Glfw includes:
+// Use OpenGL ES 3.x
+#define GLFW_INCLUDE_ES3
+#include <GLFW/glfw3.h>
+
+// Std includes:
+#include <cstdlib>
+#include <iostream>
+
+inastitch::opengl::TextureRing::TextureRing(uint32_t textureCount, uint32_t layerCount, bool isYuv, uint32_t maxWidth, uint32_t maxHeight)
+    : m_isYuv(isYuv)
+    , m_planeCount(isYuv ? maxPlaneCount : 1)
+    , m_layerCount(layerCount)
+    // Note: YUV planes are padded to a whole count of chroma samples (i.e., up to 4 pixels wide and 2 rows high)
+    , m_width(isYuv ? (maxWidth + 3) / 4 * 4 : maxWidth)
+    , m_height(isYuv ? (maxHeight + 1) / 2 * 2 : maxHeight)
+    , m_slots(textureCount)
+{
+    const GLenum internalFormat = m_isYuv ? GL_R8 : GL_RGBA8;
+
+    for(auto &slot : m_slots)
+    {
+        slot.layerScales.resize(m_layerCount, { 1.0f, 1.0f, 1.0f, 1.0f });
+
+        GL_CHECK( glGenTextures(m_planeCount, slot.textures) );
+        for(uint32_t planeIdx=0; planeIdx<m_planeCount; planeIdx++)
+        {
+            GL_CHECK( glBindTexture(GL_TEXTURE_2D_ARRAY, slot.textures[planeIdx]) );
+            GL_CHECK( glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE) );
+            GL_CHECK( glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE) );
+            GL_CHECK( glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST) );
+            // Note: linear filtering upsamples chroma planes
+            GL_CHECK( glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, (planeIdx == 0) ? GL_NEAREST : GL_LINEAR) );
+            GL_CHECK( glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, internalFormat, m_width, m_height, m_layerCount) );
+        }
+    }
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D_ARRAY, 0) );
+}
+
+inastitch::opengl::TextureRing::~TextureRing()
+{
+    for(auto &slot : m_slots)
+    {
+        GL_CHECK( glDeleteTextures(m_planeCount, slot.textures) );
+    }
+}
+
+void inastitch::opengl::TextureRing::advance()
+{
+    m_slotIdx = (m_slotIdx + 1) % m_slots.size();
+}
+
+void inastitch::opengl::TextureRing::upload(uint32_t layerIdx, const jpeg::Frame &frame, PixelUnpackRing *pixelUnpackRing)
+{
+    auto &slot = m_slots[m_slotIdx];
+
+    // Note: with a bound pixel unpack buffer, texture updates are asynchronous and take offsets instead of pointers
+    const bool isPboBound = (pixelUnpackRing != nullptr) && pixelUnpackRing->bind(frame);
+    auto getPixels = [&](const uint8_t *pixels) -> const void*
+    {
+        return isPboBound ? PixelUnpackRing::pixelOffset(frame, pixels) : pixels;
+    };
+
+    auto uploadPlane = [&](uint32_t planeIdx, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                           uint32_t fullWidth, uint32_t fullHeight, const uint8_t* pixels)
+    {
+        const GLenum format = m_isYuv ? GL_RED : GL_RGBA;
+
+        if( (fullWidth > m_width) || (fullHeight > m_height) ) {
+            std::cerr << "Error: frame plane " << fullWidth << "x" << fullHeight
+                      << " is larger than the input texture " << m_width << "x" << m_height << std::endl;
+            std::abort();
+        }
+
+        GL_CHECK( glBindTexture(GL_TEXTURE_2D_ARRAY, slot.textures[planeIdx]) );
+        GL_CHECK( glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, layerIdx, width, height, 1, format, GL_UNSIGNED_BYTE, getPixels(pixels)) );
+
+        auto &layerScale = slot.layerScales[layerIdx];
+        const auto scaleIdx = (planeIdx == 0) ? 0 : 2;
+        layerScale[scaleIdx] = static_cast<float>(fullWidth) / m_width;
+        layerScale[scaleIdx + 1] = static_cast<float>(fullHeight) / m_height;
+    };
+
+    if(!m_isYuv)
+    {
+        // Note: only the decoded (i.e., visible) region is uploaded
+        uploadPlane(0, frame.cropX, frame.cropY, frame.width, frame.height, frame.fullWidth, frame.fullHeight, frame.buffer);
+    }
+    else
+    {
+        for(uint32_t planeIdx=0; planeIdx<m_planeCount; planeIdx++)
+        {
+            const auto planeWidth = frame.yuvPlaneWidths[planeIdx];
+            const auto planeHeight = frame.yuvPlaneHeights[planeIdx];
+            uploadPlane(planeIdx, 0, 0, planeWidth, planeHeight, planeWidth, planeHeight, frame.yuvPlanes[planeIdx]);
+        }
+    }
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D_ARRAY, 0) );
+
+    if(isPboBound) pixelUnpackRing->unbind();
+}
+
+void inastitch::opengl::TextureRing::bind() const
+{
+    const auto &slot = m_slots[m_slotIdx];
+    for(uint32_t planeIdx=m_planeCount; planeIdx-- > 0; )
+    {
+        GL_CHECK( glActiveTexture(GL_TEXTURE0 + planeIdx) );
+        GL_CHECK( glBindTexture(GL_TEXTURE_2D_ARRAY, slot.textures[planeIdx]) );
+    }
+}
@@ -0,0 +1,74 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/opengl/include/VirtualView.hpp"
+
+// Std includes:
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+bool inastitch::opengl::VirtualView::parse(const std::string &viewStr, float &pan, float &tilt, float &zoom)
+{
+    std::string str = viewStr;
+    std::replace(str.begin(), str.end(), ',', ' ');
+
+    int endPos = 0;
+    if(sscanf(str.c_str(), "%f %f %f %n", &pan, &tilt, &zoom, &endPos) != 3) {
+        return false;
+    }
+    if(static_cast<size_t>(endPos) != str.size()) {
+        return false;
+    }
+
+    return std::isfinite(pan) && std::isfinite(tilt) && std::isfinite(zoom) && (zoom > 0.0f);
+}
+
+void inastitch::opengl::VirtualView::set(float pan, float tilt, float zoom)
+{
+    m_zoom = std::max(zoom, 1.0f);
+
+    // Note: a view taller than the output is centered vertically
+    const float maxPan = std::max(1.0f - 1.0f / m_zoom, 0.0f);
+    const float maxTilt = std::max(1.0f - 1.0f / (m_zoom * m_aspectRatio), 0.0f);
+    m_pan = std::min(std::max(pan, -maxPan), maxPan);
+    m_tilt = std::min(std::max(tilt, -maxTilt), maxTilt);
+}
+
+void inastitch::opengl::VirtualView::move(float panDelta, float tiltDelta)
+{
+    set(m_pan + panDelta / m_zoom, m_tilt + tiltDelta / (m_zoom * m_aspectRatio), m_zoom);
+}
+
+void inastitch::opengl::VirtualView::scale(float zoomFactor)
+{
+    set(m_pan, m_tilt, m_zoom * zoomFactor);
+}
+
+void inastitch::opengl::VirtualView::setAspectRatio(float aspectRatio)
+{
+    m_aspectRatio = aspectRatio;
+    set(m_pan, m_tilt, m_zoom);
+}
+
+glm::mat4 inastitch::opengl::VirtualView::matrix() const
+{
+    // Note: scales around the view center, in homogeneous coordinates (i.e., x' = (x - pan * w) * zoom)
+    glm::mat4 viewMat(1.0f);
+    viewMat[0][0] = m_zoom;
+    viewMat[1][1] = m_zoom * m_aspectRatio;
+    viewMat[3][0] = -m_pan * m_zoom;
+    viewMat[3][1] = -m_tilt * m_zoom * m_aspectRatio;
+    return viewMat;
+}
+
+bool inastitch::opengl::VirtualView::isVisible(const glm::vec2 &ndcMin, const glm::vec2 &ndcMax) const
+{
+    const float halfWidth = 1.0f / m_zoom;
+    const float halfHeight = 1.0f / (m_zoom * m_aspectRatio);
+    return (ndcMax.x >= m_pan - halfWidth) && (ndcMin.x <= m_pan + halfWidth) &&
+           (ndcMax.y >= m_tilt - halfHeight) && (ndcMin.y <= m_tilt + halfHeight);
+}
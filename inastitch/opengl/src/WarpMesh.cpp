@@ -0,0 +1,230 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/opengl/include/WarpMesh.hpp"
+#include "inastitch/opengl/include/OpenGlHelper.hpp"
+
+// Glfw includes:
+// Use OpenGL ES 3.x
+#define GLFW_INCLUDE_ES3
+#include <GLFW/glfw3.h>
+
+// Std includes:
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+inastitch::opengl::WarpMesh::WarpMesh(uint32_t streamCount, uint32_t gridWidth, uint32_t gridHeight)
+    : m_streamCount(streamCount)
+    , m_gridWidth(gridWidth)
+    , m_gridHeight(gridHeight)
+{
+    const uint32_t streamVertexCount = (m_gridWidth + 1) * (m_gridHeight + 1);
+    m_vertices.resize(m_streamCount * streamVertexCount);
+    m_boundsMin.resize(m_streamCount, glm::vec2(-std::numeric_limits<float>::infinity()));
+    m_boundsMax.resize(m_streamCount, glm::vec2(std::numeric_limits<float>::infinity()));
+
+    // two triangles per cell, same winding as the planar quad
+    m_indices.reserve(m_streamCount * m_gridWidth * m_gridHeight * 6);
+    for(uint32_t streamIdx=0; streamIdx<m_streamCount; streamIdx++)
+    {
+        const uint32_t baseIdx = streamIdx * streamVertexCount;
+        for(uint32_t row=0; row<m_gridHeight; row++)
+        {
+            for(uint32_t col=0; col<m_gridWidth; col++)
+            {
+                const uint32_t idx00 = baseIdx + row * (m_gridWidth + 1) + col;
+                const uint32_t idx01 = idx00 + 1;
+                const uint32_t idx10 = idx00 + (m_gridWidth + 1);
+                const uint32_t idx11 = idx10 + 1;
+                m_indices.insert(m_indices.end(), { idx00, idx10, idx11, idx11, idx01, idx00 });
+            }
+        }
+    }
+}
+
+inastitch::opengl::WarpMesh::~WarpMesh()
+{
+    if(m_vertexArray != 0)
+    {
+        GL_CHECK( glDeleteBuffers(1, &m_indexBuffer) );
+        GL_CHECK( glDeleteBuffers(1, &m_vertexBuffer) );
+        GL_CHECK( glDeleteVertexArrays(1, &m_vertexArray) );
+    }
+}
+
+bool inastitch::opengl::WarpMesh::parseProjection(const std::string &projectionName, Projection &projection)
+{
+    if(projectionName == "rectilinear") {
+        projection = Projection::Rectilinear;
+    } else if(projectionName == "cylindrical") {
+        projection = Projection::Cylindrical;
+    } else if(projectionName == "spherical") {
+        projection = Projection::Spherical;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+glm::vec2 inastitch::opengl::WarpMesh::distort(const Lens &lens, const glm::vec2 &texCoord)
+{
+    // Note: model applies to one period of the (repeated) texture
+    const glm::vec2 period = glm::floor(texCoord);
+    const glm::vec2 normPos = (texCoord - period - lens.center) / lens.focal;
+
+    const float x = normPos.x, y = normPos.y;
+    const float r2 = x * x + y * y;
+    const float radial = 1.0f + r2 * (lens.k1 + r2 * (lens.k2 + r2 * lens.k3));
+    const glm::vec2 distPos(
+        x * radial + 2.0f * lens.p1 * x * y + lens.p2 * (r2 + 2.0f * x * x),
+        y * radial + lens.p1 * (r2 + 2.0f * y * y) + 2.0f * lens.p2 * x * y);
+
+    return period + distPos * lens.focal + lens.center;
+}
+
+void inastitch::opengl::WarpMesh::bake(
+    uint32_t streamIdx,
+    const glm::mat4 &projMat, const glm::mat4 &viewModelMat, const glm::mat3 &warpMat,
+    const Lens *lens, Projection projection,
+    const glm::vec2 &posAtUv00, const glm::vec2 &posAtUv11)
+{
+    const uint32_t streamVertexCount = (m_gridWidth + 1) * (m_gridHeight + 1);
+    Vertex* const vertices = m_vertices.data() + streamIdx * streamVertexCount;
+
+    glm::vec2 ndcMin(std::numeric_limits<float>::infinity());
+    glm::vec2 ndcMax(-std::numeric_limits<float>::infinity());
+    bool isBehind = false;
+
+    for(uint32_t row=0; row<=m_gridHeight; row++)
+    {
+        for(uint32_t col=0; col<=m_gridWidth; col++)
+        {
+            const float u = static_cast<float>(col) / m_gridWidth;
+            const float v = static_cast<float>(row) / m_gridHeight;
+            auto &vertex = vertices[row * (m_gridWidth + 1) + col];
+            vertex.streamIdx = streamIdx;
+
+            const glm::vec4 viewPos = viewModelMat * glm::vec4(
+                posAtUv00.x + (posAtUv11.x - posAtUv00.x) * u,
+                posAtUv00.y + (posAtUv11.y - posAtUv00.y) * v,
+                0.0f, 1.0f);
+            const glm::vec4 clipPos = projMat * viewPos;
+
+            if( (projection == Projection::Rectilinear) || (clipPos.w <= 0.0f) )
+            {
+                // Note: kept in clip space, for perspective-correct interpolation
+                vertex.position = clipPos;
+            }
+            else
+            {
+                // Note: same scale as the planar projection at the center of the output
+                const glm::vec3 dir = glm::vec3(viewPos) / viewPos.w;
+                const float horizDist = std::sqrt(dir.x * dir.x + dir.z * dir.z);
+                const float azimuth = std::atan2(dir.x, -dir.z);
+                const float elevation = (projection == Projection::Cylindrical) ?
+                    dir.y / horizDist : std::atan2(dir.y, horizDist);
+                vertex.position = glm::vec4(azimuth * projMat[0][0], elevation * projMat[1][1], clipPos.z / clipPos.w, 1.0f);
+            }
+
+            if(vertex.position.w > 0.0f)
+            {
+                const glm::vec2 ndcPos(vertex.position.x / vertex.position.w, vertex.position.y / vertex.position.w);
+                ndcMin = glm::min(ndcMin, ndcPos);
+                ndcMax = glm::max(ndcMax, ndcPos);
+            }
+            else
+            {
+                isBehind = true;
+            }
+
+            // same as the former per-pixel warp
+            const glm::vec3 dst = warpMat * glm::vec3(u + 1.0f, v, 1.0f);
+            vertex.texCoord = glm::vec2(dst.x / dst.z, dst.y / dst.z);
+            if(lens)
+            {
+                vertex.texCoord = distort(*lens, vertex.texCoord);
+            }
+        }
+    }
+
+    // Note: a quad crossing the plane of the viewer projects to an unbounded area
+    if(isBehind)
+    {
+        ndcMin = glm::vec2(-std::numeric_limits<float>::infinity());
+        ndcMax = glm::vec2(std::numeric_limits<float>::infinity());
+    }
+    m_boundsMin[streamIdx] = ndcMin;
+    m_boundsMax[streamIdx] = ndcMax;
+}
+
+void inastitch::opengl::WarpMesh::bounds(uint32_t streamIdx, glm::vec2 &ndcMin, glm::vec2 &ndcMax) const
+{
+    ndcMin = m_boundsMin[streamIdx];
+    ndcMax = m_boundsMax[streamIdx];
+}
+
+inastitch::opengl::helper::TextureFootprint inastitch::opengl::WarpMesh::footprint(
+    uint32_t streamIdx, const glm::mat4 &viewMat,
+    uint32_t textureWidth, uint32_t textureHeight,
+    uint32_t outWidth, uint32_t outHeight) const
+{
+    const uint32_t streamVertexCount = (m_gridWidth + 1) * (m_gridHeight + 1);
+    const Vertex* const vertices = m_vertices.data() + streamIdx * streamVertexCount;
+
+    // same as vertex shader
+    std::vector<glm::vec4> clipPositions(streamVertexCount);
+    std::vector<glm::vec2> texCoords(streamVertexCount);
+    for(uint32_t idx=0; idx<streamVertexCount; idx++)
+    {
+        clipPositions[idx] = viewMat * vertices[idx].position;
+        texCoords[idx] = vertices[idx].texCoord;
+    }
+
+    return helper::getTextureFootprint(m_gridWidth, m_gridHeight, clipPositions.data(), texCoords.data(),
+                                       textureWidth, textureHeight, outWidth, outHeight);
+}
+
+void inastitch::opengl::WarpMesh::upload()
+{
+    GL_CHECK( glGenVertexArrays(1, &m_vertexArray) );
+    GL_CHECK( glBindVertexArray(m_vertexArray) );
+
+    GL_CHECK( glGenBuffers(1, &m_vertexBuffer) );
+    GL_CHECK( glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer) );
+    GL_CHECK( glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(Vertex), m_vertices.data(), GL_STATIC_DRAW) );
+    GL_CHECK( glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, position)) );
+    GL_CHECK( glEnableVertexAttribArray(0) );
+    GL_CHECK( glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, texCoord)) );
+    GL_CHECK( glEnableVertexAttribArray(1) );
+    GL_CHECK( glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, streamIdx)) );
+    GL_CHECK( glEnableVertexAttribArray(2) );
+
+    GL_CHECK( glGenBuffers(1, &m_indexBuffer) );
+    GL_CHECK( glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer) );
+    GL_CHECK( glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(uint32_t), m_indices.data(), GL_STATIC_DRAW) );
+
+    GL_CHECK( glBindVertexArray(0) );
+    GL_CHECK( glBindBuffer(GL_ARRAY_BUFFER, 0) );
+    GL_CHECK( glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0) );
+}
+
+void inastitch::opengl::WarpMesh::draw() const
+{
+    GL_CHECK( glBindVertexArray(m_vertexArray) );
+    GL_CHECK( glDrawElements(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_INT, nullptr) );
+    GL_CHECK( glBindVertexArray(0) );
+}
+
+void inastitch::opengl::WarpMesh::draw(uint32_t streamIdx) const
+{
+    // Note: indices are grouped by stream
+    const uint32_t streamIndexCount = m_gridWidth * m_gridHeight * 6;
+    GL_CHECK( glBindVertexArray(m_vertexArray) );
+    GL_CHECK( glDrawElements(GL_TRIANGLES, streamIndexCount, GL_UNSIGNED_INT,
+                             (GLvoid*)(static_cast<uintptr_t>(streamIdx) * streamIndexCount * sizeof(uint32_t))) );
+    GL_CHECK( glBindVertexArray(0) );
+}
@@ -0,0 +1,194 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/opengl/include/YuvPacker.hpp"
+#include "inastitch/opengl/include/OpenGlHelper.hpp"
+
+// Glfw includes:
+// Use OpenGL ES 3.x
+#define GLFW_INCLUDE_ES3
+#include <GLFW/glfw3.h>
+
+// Std includes:
+#include <iostream>
+
+static const GLchar* packVertexShaderSource = R""""(
+#version 100
+precision highp float;
+
+attribute vec2 position;
+
+void main() {
+   gl_Position = vec4(position, 0.0, 1.0);
+}
+)"""";
+
+// Note: one output pixel packs 4 horizontally consecutive samples of the plane,
+//       each sample being the average of 'sampleStep' scene pixels (i.e., linear filtering).
+static const GLchar* packFragmentShaderSource = R""""(
+#version 100
+precision highp float;
+
+uniform sampler2D scene;
+uniform vec2 sceneSize;
+uniform vec2 sampleStep;
+uniform vec4 coeffs;
+
+float getSample(float x, float y) {
+   // Note: plane rows are top-down, scene rows are bottom-up
+   vec2 scenePos = vec2((x + 0.5) * sampleStep.x, sceneSize.y - (y + 0.5) * sampleStep.y);
+   vec3 rgb = texture2D(scene, scenePos / sceneSize).rgb;
+   return clamp(dot(rgb, coeffs.rgb) + coeffs.a, 0.0, 1.0);
+}
+
+void main() {
+   float x = floor(gl_FragCoord.x) * 4.0;
+   float y = floor(gl_FragCoord.y);
+   gl_FragColor = vec4(getSample(x, y), getSample(x + 1.0, y), getSample(x + 2.0, y), getSample(x + 3.0, y));
+}
+)"""";
+
+// JFIF (full range) RGB to YCbCr
+static const GLfloat planeCoeffs[inastitch::opengl::YuvPacker::planeCount][4] = {
+    {  0.299f,     0.587f,     0.114f,    0.0f },
+    { -0.168736f, -0.331264f,  0.5f,      0.5f },
+    {  0.5f,      -0.418688f, -0.081312f, 0.5f }
+};
+
+static const GLfloat fullscreenVertices[] = {
+    -1.0f, -1.0f,   1.0f, -1.0f,   1.0f,  1.0f,
+     1.0f,  1.0f,  -1.0f,  1.0f,  -1.0f, -1.0f
+};
+
+inastitch::opengl::YuvPacker::YuvPacker(uint32_t width, uint32_t height)
+    : m_width(width)
+    , m_height(height)
+{
+    if( (m_width % 8 != 0) || (m_height % 2 != 0) ) {
+        std::cerr << "Error: YUV output size " << m_width << "x" << m_height << " is not a multiple of 8x2." << std::endl;
+        std::abort();
+    }
+
+    // 4:2:0 subsampling
+    m_planeWidths[0] = m_width;
+    m_planeHeights[0] = m_height;
+    m_planeWidths[1] = m_planeWidths[2] = m_width / 2;
+    m_planeHeights[1] = m_planeHeights[2] = m_height / 2;
+    m_planeOffsets[0] = 0;
+    m_planeOffsets[1] = m_planeOffsets[0] + m_planeWidths[0] * m_planeHeights[0];
+    m_planeOffsets[2] = m_planeOffsets[1] + m_planeWidths[1] * m_planeHeights[1];
+
+    // Note: linear filtering averages the chroma samples
+    GL_CHECK( glGenTextures(1, &m_sceneTexture) );
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D, m_sceneTexture) );
+    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE) );
+    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE) );
+    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR) );
+    GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR) );
+    GL_CHECK( glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr) );
+
+    // Note: rendering framebuffer is not necessarily the default one (see "HeadlessContext.hpp")
+    GLint framebuffer;
+    GL_CHECK( glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer) );
+
+    GL_CHECK( glGenTextures(planeCount, m_planeTextures) );
+    GL_CHECK( glGenFramebuffers(planeCount, m_planeFramebuffers) );
+    for(uint32_t planeIdx=0; planeIdx<planeCount; planeIdx++)
+    {
+        GL_CHECK( glBindTexture(GL_TEXTURE_2D, m_planeTextures[planeIdx]) );
+        GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST) );
+        GL_CHECK( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST) );
+        GL_CHECK( glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_planeWidths[planeIdx] / 4, m_planeHeights[planeIdx], 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr) );
+
+        GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, m_planeFramebuffers[planeIdx]) );
+        GL_CHECK( glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_planeTextures[planeIdx], 0) );
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Error: YUV plane framebuffer is incomplete." << std::endl;
+            std::abort();
+        }
+    }
+    GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, framebuffer) );
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D, 0) );
+
+    m_shaderProgram = helper::getShaderProgram(packVertexShaderSource, packFragmentShaderSource);
+    GL_CHECK( glUseProgram(m_shaderProgram) );
+    GL_CHECK( glUniform1i(glGetUniformLocation(m_shaderProgram, "scene"), 0) );
+    GL_CHECK( glUniform2f(glGetUniformLocation(m_shaderProgram, "sceneSize"), m_width, m_height) );
+    GL_CHECK( m_coeffsUni = glGetUniformLocation(m_shaderProgram, "coeffs") );
+    GL_CHECK( m_sampleStepUni = glGetUniformLocation(m_shaderProgram, "sampleStep") );
+    GL_CHECK( glUseProgram(0) );
+
+    // Note: own vertex array, so that the attributes of the main shader are left untouched
+    GL_CHECK( glGenVertexArrays(1, &m_vertexArray) );
+    GL_CHECK( glBindVertexArray(m_vertexArray) );
+    GL_CHECK( glGenBuffers(1, &m_vertexBuffer) );
+    GL_CHECK( glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer) );
+    GL_CHECK( glBufferData(GL_ARRAY_BUFFER, sizeof(fullscreenVertices), fullscreenVertices, GL_STATIC_DRAW) );
+    const GLint positionAttrib = glGetAttribLocation(m_shaderProgram, "position");
+    GL_CHECK( glVertexAttribPointer(positionAttrib, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (GLvoid*)0) );
+    GL_CHECK( glEnableVertexAttribArray(positionAttrib) );
+    GL_CHECK( glBindVertexArray(0) );
+    GL_CHECK( glBindBuffer(GL_ARRAY_BUFFER, 0) );
+}
+
+inastitch::opengl::YuvPacker::~YuvPacker()
+{
+    GL_CHECK( glDeleteBuffers(1, &m_vertexBuffer) );
+    GL_CHECK( glDeleteVertexArrays(1, &m_vertexArray) );
+    GL_CHECK( glDeleteProgram(m_shaderProgram) );
+    GL_CHECK( glDeleteFramebuffers(planeCount, m_planeFramebuffers) );
+    GL_CHECK( glDeleteTextures(planeCount, m_planeTextures) );
+    GL_CHECK( glDeleteTextures(1, &m_sceneTexture) );
+}
+
+void inastitch::opengl::YuvPacker::pack()
+{
+    GLint framebuffer, viewport[4];
+    GL_CHECK( glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer) );
+    GL_CHECK( glGetIntegerv(GL_VIEWPORT, viewport) );
+    const GLboolean isDepthTestEnabled = glIsEnabled(GL_DEPTH_TEST);
+
+    // Note: copy stays on the GPU
+    GL_CHECK( glActiveTexture(GL_TEXTURE0) );
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D, m_sceneTexture) );
+    GL_CHECK( glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, m_width, m_height) );
+
+    GL_CHECK( glDisable(GL_DEPTH_TEST) );
+    GL_CHECK( glUseProgram(m_shaderProgram) );
+    GL_CHECK( glBindVertexArray(m_vertexArray) );
+    for(uint32_t planeIdx=0; planeIdx<planeCount; planeIdx++)
+    {
+        const float sampleStep = static_cast<float>(m_width) / m_planeWidths[planeIdx];
+
+        GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, m_planeFramebuffers[planeIdx]) );
+        GL_CHECK( glViewport(0, 0, m_planeWidths[planeIdx] / 4, m_planeHeights[planeIdx]) );
+        GL_CHECK( glUniform4fv(m_coeffsUni, 1, planeCoeffs[planeIdx]) );
+        GL_CHECK( glUniform2f(m_sampleStepUni, sampleStep, sampleStep) );
+        GL_CHECK( glDrawArrays(GL_TRIANGLES, 0, 6) );
+    }
+    GL_CHECK( glBindVertexArray(0) );
+    GL_CHECK( glBindTexture(GL_TEXTURE_2D, 0) );
+
+    GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, framebuffer) );
+    GL_CHECK( glViewport(viewport[0], viewport[1], viewport[2], viewport[3]) );
+    if(isDepthTestEnabled) {
+        GL_CHECK( glEnable(GL_DEPTH_TEST) );
+    }
+}
+
+void inastitch::opengl::YuvPacker::readPixels(uint8_t* buffer)
+{
+    GLint framebuffer;
+    GL_CHECK( glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer) );
+
+    for(uint32_t planeIdx=0; planeIdx<planeCount; planeIdx++)
+    {
+        GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, m_planeFramebuffers[planeIdx]) );
+        GL_CHECK( glReadPixels(0, 0, m_planeWidths[planeIdx] / 4, m_planeHeights[planeIdx], GL_RGBA, GL_UNSIGNED_BYTE, buffer + m_planeOffsets[planeIdx]) );
+    }
+
+    GL_CHECK( glBindFramebuffer(GL_FRAMEBUFFER, framebuffer) );
+}
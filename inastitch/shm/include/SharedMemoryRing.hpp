@@ -0,0 +1,111 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Std includes:
+#include <cstdint>
+#include <atomic>
+#include <string>
+
+namespace inastitch {
+namespace shm {
+
+
+// Memory layout, shared with consumer processes:
+//   RingHeader, then 'slotCount' times (SlotHeader, 'slotSize' bytes of data).
+// Note: headers and slot data are aligned to 'alignment' bytes
+//
+// Consumers read the latest frame without copy:
+//   1. read 'RingHeader::latestSeq' (0 means no frame yet), slot is 'latestSeq % slotCount'
+//   2. read 'SlotHeader::seq', it must be even and equal to '2 * latestSeq'
+//   3. use slot data in place
+//   4. read 'SlotHeader::seq' again, if it changed, the frame was overwritten meanwhile
+static const uint32_t ringMagic = 0x494E4153; // "INAS"
+static const uint32_t ringVersion = 1;
+static const uint32_t alignment = 64;
+
+enum class FrameFormat : uint32_t
+{
+    Rgba = 0, // bottom-up, as read back from OpenGL
+    I420 = 1, // JFIF YCbCr 4:2:0 planes, top-down
+    Jpeg = 2
+};
+
+// Note: atomics in shared memory only work across processes when lock-free (i.e., address-free)
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "64-bit atomics must be lock-free to be shared between processes");
+
+struct alignas(alignment) RingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotSize;
+    // sequence number of the latest complete frame
+    std::atomic<uint64_t> latestSeq;
+};
+
+struct alignas(alignment) SlotHeader
+{
+    // Note: odd while the slot is being written (i.e., sequence lock)
+    std::atomic<uint64_t> seq;
+
+    FrameFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t dataSize;
+
+    uint64_t frameIdx;
+    // absolute time since epoch (in us)
+    uint64_t absTime;
+    uint64_t relTime;
+    uint64_t offTime;
+};
+
+// Ring of frames published to a POSIX shared memory object (or a memfd) for local consumers.
+// Note: single writer, the writer never waits for consumers
+class SharedMemoryRing
+{
+public:
+    // Note: 'name' is a POSIX shared memory name (e.g., "/inastitch"),
+    //       or "memfd:NAME" for an anonymous memfd (i.e., mapped by consumers through /proc/PID/fd/FD)
+    SharedMemoryRing(const std::string &name, uint32_t slotCount, uint32_t slotSize);
+    ~SharedMemoryRing();
+
+public:
+    // Returns the data of the next slot, to be written directly
+    uint8_t* beginWrite();
+
+    // Publishes the slot being written
+    void endWrite(FrameFormat format, uint32_t width, uint32_t height, uint32_t dataSize,
+                  uint64_t frameIdx, uint64_t absTime, uint64_t relTime, uint64_t offTime);
+
+    uint32_t slotSize() const
+    {
+        return m_slotSize;
+    }
+
+private:
+    SlotHeader* slotHeader(uint64_t seq) const;
+
+private:
+    const std::string m_name;
+    const bool m_isMemfd;
+    const uint32_t m_slotCount;
+    const uint32_t m_slotSize;
+    const uint32_t m_slotStride;
+    const uint64_t m_mapSize;
+
+private:
+    int m_fd;
+    uint8_t* m_map;
+    RingHeader* m_ringHeader;
+    // sequence number of the frame being written
+    uint64_t m_writeSeq = 0;
+};
+
+
+} // namespace shm
+} // namespace inastitch
@@ -0,0 +1,126 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/shm/include/SharedMemoryRing.hpp"
+
+// C includes:
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Std includes:
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+namespace {
+
+const std::string memfdPrefix = "memfd:";
+
+uint32_t alignUp(uint32_t size)
+{
+    return (size + inastitch::shm::alignment - 1) / inastitch::shm::alignment * inastitch::shm::alignment;
+}
+
+} // namespace
+
+inastitch::shm::SharedMemoryRing::SharedMemoryRing(const std::string &name, uint32_t slotCount, uint32_t slotSize)
+    : m_name(name)
+    , m_isMemfd(name.compare(0, memfdPrefix.size(), memfdPrefix) == 0)
+    , m_slotCount(slotCount)
+    , m_slotSize(slotSize)
+    , m_slotStride(alignUp(sizeof(SlotHeader) + slotSize))
+    , m_mapSize(alignUp(sizeof(RingHeader)) + static_cast<uint64_t>(m_slotStride) * slotCount)
+{
+    if(m_isMemfd) {
+        m_fd = memfd_create(name.substr(memfdPrefix.size()).c_str(), MFD_CLOEXEC);
+    } else {
+        m_fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    }
+    if(m_fd < 0)
+    {
+        perror("Error: shared memory creation failed");
+        std::abort();
+    }
+
+    if(ftruncate(m_fd, m_mapSize) < 0)
+    {
+        perror("Error: shared memory resize failed");
+        std::abort();
+    }
+
+    void* const map = mmap(nullptr, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if(map == MAP_FAILED)
+    {
+        perror("Error: shared memory mapping failed");
+        std::abort();
+    }
+    m_map = static_cast<uint8_t*>(map);
+
+    // Note: memory is zeroed by 'ftruncate', so all slots start with seq=0 (i.e., empty)
+    m_ringHeader = new (m_map) RingHeader;
+    m_ringHeader->magic = ringMagic;
+    m_ringHeader->version = ringVersion;
+    m_ringHeader->slotCount = m_slotCount;
+    m_ringHeader->slotSize = m_slotSize;
+    m_ringHeader->latestSeq.store(0, std::memory_order_release);
+    for(uint32_t slotIdx=0; slotIdx<m_slotCount; slotIdx++) {
+        new (slotHeader(slotIdx)) SlotHeader;
+    }
+
+    if(m_isMemfd) {
+        std::cout << "Publishing frames to /proc/" << getpid() << "/fd/" << m_fd << std::endl;
+    } else {
+        std::cout << "Publishing frames to shared memory " << m_name << std::endl;
+    }
+}
+
+inastitch::shm::SharedMemoryRing::~SharedMemoryRing()
+{
+    munmap(m_map, m_mapSize);
+    close(m_fd);
+    if(!m_isMemfd) {
+        shm_unlink(m_name.c_str());
+    }
+}
+
+inastitch::shm::SlotHeader* inastitch::shm::SharedMemoryRing::slotHeader(uint64_t seq) const
+{
+    const uint32_t slotIdx = seq % m_slotCount;
+    return reinterpret_cast<SlotHeader*>(m_map + alignUp(sizeof(RingHeader)) + static_cast<uint64_t>(m_slotStride) * slotIdx);
+}
+
+uint8_t* inastitch::shm::SharedMemoryRing::beginWrite()
+{
+    // Note: sequence numbers start at 1, 0 meaning "no frame"
+    m_writeSeq++;
+
+    SlotHeader* const header = slotHeader(m_writeSeq);
+    // odd, consumers of the previous frame in this slot will detect the overwrite
+    header->seq.store(2 * m_writeSeq - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    return reinterpret_cast<uint8_t*>(header) + sizeof(SlotHeader);
+}
+
+void inastitch::shm::SharedMemoryRing::endWrite(FrameFormat format, uint32_t width, uint32_t height, uint32_t dataSize,
+                                                uint64_t frameIdx, uint64_t absTime, uint64_t relTime, uint64_t offTime)
+{
+    SlotHeader* const header = slotHeader(m_writeSeq);
+    header->format = format;
+    header->width = width;
+    header->height = height;
+    header->dataSize = dataSize;
+    header->frameIdx = frameIdx;
+    header->absTime = absTime;
+    header->relTime = relTime;
+    header->offTime = offTime;
+
+    header->seq.store(2 * m_writeSeq, std::memory_order_release);
+    m_ringHeader->latestSeq.store(m_writeSeq, std::memory_order_release);
+}
@@ -0,0 +1,98 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// Local includes:
+#include "inastitch/jpeg/include/FramePool.hpp"
+
+// Std includes:
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace inastitch {
+namespace video {
+
+
+// Writes YUV 4:2:0 frames as Y4M, raw I420 or raw NV12 to a file or a pipe (e.g., to feed a video encoder),
+// with one PTS line per frame in a side file (as for MJPEG output).
+// Note: frames are written by a dedicated thread, so that a slow pipe does not stall rendering
+class RawVideoWriter
+{
+public:
+    enum class Format
+    {
+        Y4m,
+        I420,
+        Nv12
+    };
+
+    struct FrameInfo
+    {
+        // absolute time since epoch (in us)
+        uint64_t absTime = 0;
+        uint64_t relTime = 0;
+        uint64_t offTime = 0;
+    };
+
+public:
+    // Note: 'filename' can be a named pipe, PTS are written to 'filename'.pts
+    RawVideoWriter(const std::string &filename, Format format,
+                   uint32_t width, uint32_t height, uint32_t frameRate,
+                   uint32_t maxQueueSize, uint32_t frameBufferSize);
+    ~RawVideoWriter();
+
+public:
+    // Note: format name is "y4m", "i420" or "nv12", returns false if unknown
+    static bool parseFormat(const std::string &formatName, Format &format);
+
+    // Returns a frame to read pixels into, or nullptr when the queue is full (i.e., frame is dropped).
+    // Note: only needed when frames are not shared with another output
+    std::shared_ptr<jpeg::Frame> acquireFrame(bool isBlocking);
+
+    // Note: frame must hold YUV 4:2:0 planes, it is only read (i.e., it can be shared with the encoder)
+    void push(std::shared_ptr<jpeg::Frame> frame, const FrameInfo &info, bool isBlocking);
+
+    // Note: waits for all pushed frames to be written
+    void flush();
+
+    uint64_t droppedCount();
+
+private:
+    void writeLoop();
+    void writeFrame(const jpeg::Frame &frame, const FrameInfo &info);
+
+private:
+    const Format m_format;
+    const uint32_t m_width;
+    const uint32_t m_height;
+    const uint32_t m_maxQueueSize;
+    jpeg::FramePool m_framePool;
+
+    std::ofstream m_file;
+    std::ofstream m_ptsFile;
+    // interleaved chroma for NV12
+    std::vector<uint8_t> m_chromaBuffer;
+
+    std::thread m_writeThread;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::pair<std::shared_ptr<jpeg::Frame>, FrameInfo>> m_frames;
+    bool m_isStopping = false;
+    uint64_t m_droppedCount = 0;
+};
+
+
+} // namespace video
+} // namespace inastitch
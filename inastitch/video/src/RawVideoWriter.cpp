@@ -0,0 +1,180 @@
+// Copyright (C) 2020 Inatech srl
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Local includes:
+#include "inastitch/video/include/RawVideoWriter.hpp"
+
+// Std includes:
+#include <iostream>
+
+inastitch::video::RawVideoWriter::RawVideoWriter(
+    const std::string &filename, Format format,
+    uint32_t width, uint32_t height, uint32_t frameRate,
+    uint32_t maxQueueSize, uint32_t frameBufferSize)
+    : m_format(format)
+    , m_width(width)
+    , m_height(height)
+    , m_maxQueueSize(maxQueueSize)
+    , m_framePool(maxQueueSize + 1, frameBufferSize)
+{
+    // Note: opening a named pipe blocks until its reader is connected
+    m_file.open(filename, std::ios::binary);
+    m_ptsFile.open(filename + ".pts");
+
+    if(!m_file)
+    {
+        std::cerr << "Error: cannot open raw video output " << filename << std::endl;
+        std::abort();
+    }
+
+    if(m_format == Format::Y4m)
+    {
+        // Note: JPEG chroma siting and full range, as converted by 'YuvPacker'
+        m_file << "YUV4MPEG2 W" << m_width << " H" << m_height
+                  << " F" << frameRate << ":1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n";
+    }
+
+    if(m_format == Format::Nv12)
+    {
+        m_chromaBuffer.resize(m_width * m_height / 2);
+    }
+
+    m_writeThread = std::thread(&RawVideoWriter::writeLoop, this);
+}
+
+inastitch::video::RawVideoWriter::~RawVideoWriter()
+{
+    flush();
+}
+
+bool inastitch::video::RawVideoWriter::parseFormat(const std::string &formatName, Format &format)
+{
+    if(formatName == "y4m") {
+        format = Format::Y4m;
+    } else if(formatName == "i420") {
+        format = Format::I420;
+    } else if(formatName == "nv12") {
+        format = Format::Nv12;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<inastitch::jpeg::Frame> inastitch::video::RawVideoWriter::acquireFrame(bool isBlocking)
+{
+    if(isBlocking)
+    {
+        return m_framePool.acquire();
+    }
+
+    auto frame = m_framePool.tryAcquire();
+    if(!frame)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_droppedCount++;
+    }
+    return frame;
+}
+
+void inastitch::video::RawVideoWriter::push(std::shared_ptr<jpeg::Frame> frame, const FrameInfo &info, bool isBlocking)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if(isBlocking)
+        {
+            m_condition.wait(lock, [this]{ return m_frames.size() < m_maxQueueSize; });
+        }
+        else if(m_frames.size() >= m_maxQueueSize)
+        {
+            m_droppedCount++;
+            return;
+        }
+        m_frames.emplace_back(std::move(frame), info);
+    }
+    m_condition.notify_all();
+}
+
+void inastitch::video::RawVideoWriter::flush()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(m_isStopping)
+        {
+            return;
+        }
+        m_isStopping = true;
+    }
+    m_condition.notify_all();
+
+    m_writeThread.join();
+    m_file.flush();
+}
+
+uint64_t inastitch::video::RawVideoWriter::droppedCount()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_droppedCount;
+}
+
+void inastitch::video::RawVideoWriter::writeLoop()
+{
+    while(true)
+    {
+        std::shared_ptr<jpeg::Frame> frame;
+        FrameInfo info;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]{ return !m_frames.empty() || m_isStopping; });
+            if(m_frames.empty())
+            {
+                // stopping and everything was written
+                return;
+            }
+            std::tie(frame, info) = std::move(m_frames.front());
+            m_frames.pop_front();
+        }
+        // Note: a blocked producer can push again
+        m_condition.notify_all();
+
+        writeFrame(*frame, info);
+    }
+}
+
+void inastitch::video::RawVideoWriter::writeFrame(const jpeg::Frame &frame, const FrameInfo &info)
+{
+    if(!frame.isYuv || (frame.width != m_width) || (frame.height != m_height))
+    {
+        std::cerr << "Error: raw video output only supports " << m_width << "x" << m_height << " YUV frames" << std::endl;
+        std::abort();
+    }
+
+    const uint32_t lumaSize = m_width * m_height;
+    const uint32_t chromaPlaneSize = lumaSize / 4;
+
+    if(m_format == Format::Y4m)
+    {
+        m_file << "FRAME\n";
+    }
+
+    m_file.write(reinterpret_cast<const char*>(frame.yuvPlanes[0]), lumaSize);
+    if(m_format == Format::Nv12)
+    {
+        // Note: GPU packs planar chroma, NV12 interleaves U and V
+        for(uint32_t i=0; i<chromaPlaneSize; i++)
+        {
+            m_chromaBuffer[2*i] = frame.yuvPlanes[1][i];
+            m_chromaBuffer[2*i+1] = frame.yuvPlanes[2][i];
+        }
+        m_file.write(reinterpret_cast<const char*>(m_chromaBuffer.data()), m_chromaBuffer.size());
+    }
+    else
+    {
+        m_file.write(reinterpret_cast<const char*>(frame.yuvPlanes[1]), chromaPlaneSize);
+        m_file.write(reinterpret_cast<const char*>(frame.yuvPlanes[2]), chromaPlaneSize);
+    }
+
+    m_ptsFile << info.absTime << " " << info.relTime << " " << info.offTime << std::endl;
+}
@@ -0,0 +1,57 @@
+#!/bin/bash
+# Copyright (C) 2020 Inatech srl
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+# Measures the stitching cost per camera, from 1 to 16 input streams.
+# Every camera reads the same MJPEG file and covers the same area of the output, so that none of them
+# is culled as out of view, and the cost only depends on the camera count (i.e., decode, upload and draw).
+#
+# Usage: scaling.sh INASTITCH MJPEG_FILE [FRAME_COUNT] [INASTITCH_OPTION...]
+# e.g.:  scaling.sh build/inastitch demo_video/stream0.mjpeg 300 --in-yuv --in-pbo
+
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 INASTITCH MJPEG_FILE [FRAME_COUNT] [INASTITCH_OPTION...]"
+    exit 1
+fi
+
+INASTITCH=$1
+MJPEG_FILE=$2
+FRAME_COUNT=${3:-300}
+shift $(( $# < 3 ? $# : 3 ))
+
+MATRIX_FILE=$(mktemp --suffix=.json)
+trap 'rm -f "$MATRIX_FILE"' EXIT
+
+# same camera as "texture0" of "static/inastitch_matrix.json"
+CAMERA='{
+        "model": [ 1.5, 0.0, 0.0, 0.0,  0.0, 1.5, 0.0, 0.0,  0.0, 0.0, 1.0, 0.0,  0.0, 0.0, 0.0, 1.0 ],
+        "view":  [ 1.0, 0.0, 0.0, 0.0,  0.0, 1.0, 0.0, 0.0,  0.0, 0.0, 1.0, -0.869,  0.0, 0.0, 0.0, 1.0 ],
+        "warp":  [ 1.0, 0.0, 0.0,  0.0, 1.0, 0.0,  0.0, 0.0, 1.0 ]
+    }'
+
+printf "%8s %10s %12s %14s\n" "cameras" "fps" "ms/frame" "ms/frame/cam"
+for CAMERA_COUNT in 1 2 4 8 12 16; do
+    CAMERAS="$CAMERA"
+    IN_FILES="--in-file $MJPEG_FILE"
+    for (( i=1; i<CAMERA_COUNT; i++ )); do
+        CAMERAS="$CAMERAS, $CAMERA"
+        IN_FILES="$IN_FILES --in-file $MJPEG_FILE"
+    done
+    echo "{ \"cameras\": [ $CAMERAS ] }" > "$MATRIX_FILE"
+
+    # Note: output is not read back, only the input side of the pipeline is measured
+    # shellcheck disable=SC2086
+    RESULT=$("$INASTITCH" --headless --out-readback none --max-dump-frame "$FRAME_COUNT" \
+                          --in-matrix "$MATRIX_FILE" $IN_FILES "$@" | grep "frames rendered in")
+
+    # e.g., "300 frames rendered in 1234ms (243.1 fps)"
+    FRAMES=$(echo "$RESULT" | awk '{ print $1 }')
+    TIME_MS=$(echo "$RESULT" | sed -e 's/.* in \([0-9.]*\)ms.*/\1/')
+    # Note: a short run can take less than 1ms
+    awk -v n="$CAMERA_COUNT" -v f="$FRAMES" -v t="$TIME_MS" \
+        'BEGIN { if (t < 1) t = 1; printf "%8d %10.1f %12.2f %14.2f\n", n, f * 1000 / t, t / f, t / f / n }'
+done